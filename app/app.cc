@@ -122,7 +122,7 @@ void App::renderGui()
         bool is_selected = (this->viewer->getCurrModel()->animController->getCurrentAnimationName() == clipName);
         if (ImGui::Selectable(clipName.c_str(), is_selected))
         {
-          this->viewer->getCurrModel()->animController->setCurrentAnimation(i);
+          this->viewer->getCurrModel()->animController->crossfade(i, 0.25f);
         }
         if (is_selected)
         {
@@ -197,6 +197,72 @@ void App::renderGui()
       this->viewer->getCurrModel()->animController->stop();
     }
   }
+
+  ImGui::SeparatorText("Pose Cache");
+  PoseCache &cache = this->viewer->poseCache;
+  ImGui::Text("hits: %zu misses: %zu (%.1f%%)", cache.getHits(), cache.getMisses(),
+              100.0f * cache.getHitRate());
+  float quantum = cache.getQuantum() * 1000.0f;
+  if (ImGui::SliderFloat("time step (ms)", &quantum, 0.0f, 50.0f))
+  {
+    cache.setQuantum(quantum / 1000.0f);
+  }
+  if (ImGui::Button("Reset stats"))
+  {
+    cache.resetStats();
+  }
+
+  ImGui::SeparatorText("Draw Submission");
+  ImGui::Checkbox("multi draw indirect", &this->viewer->indirectDraws);
+  const RenderStats &stats = this->viewer->renderQueue.getStats();
+  ImGui::Text("draws: %zu programs: %zu", stats.draws, stats.programChanges);
+  ImGui::Text("textures: %zu materials: %zu uniforms: %zu", stats.textureBinds,
+              stats.materialChanges, stats.uniformUploads);
+  ImGui::Text("texture arrays: %.1f MB", this->viewer->textureMemory() / (1024.0 * 1024.0));
+
+  ImGui::Checkbox("depth prepass", &this->viewer->depthPrepass);
+  if (this->viewer->depthPrepass)
+  {
+    if (this->viewer->usesRenderQueue())
+    {
+      ImGui::Text("prepass: %zu draws %.2f ms", this->viewer->prepassStats.draws,
+                  this->viewer->prepassTime);
+    }
+    else
+    {
+      ImGui::Text("prepass: %.2f ms", this->viewer->prepassTime);
+    }
+  }
+  ImGui::Text("color pass: %.2f ms", this->viewer->colorPassTime);
+  ImGui::Checkbox("skin once per frame", &this->viewer->skinOnce);
+  ImGui::SameLine();
+  ImGui::Checkbox("on the cpu", &this->viewer->cpuSkinning);
+  const SkinningStats &skinStats = this->viewer->skinningPass.getStats();
+  ImGui::Text("skinned: %zu meshes %zu vertices", skinStats.meshes, skinStats.vertices);
+
+  const GLStateStats &glStats = GLState::getStats();
+  ImGui::Text("gl calls: %zu issued, %zu elided", glStats.issued, glStats.elided);
+
+  ImGui::SeparatorText("Lights");
+  ImGui::SliderInt("scattered lights", &this->viewer->scatteredLights, 0, 1000);
+  const LightClusterStats &lightStats = this->viewer->lightClusters.getStats();
+  ImGui::Text("lights: %zu references: %zu", lightStats.lights, lightStats.references);
+  ImGui::Text("busiest cluster: %zu dropped: %zu", lightStats.busiestCluster, lightStats.dropped);
+
+  ImGui::SeparatorText("Crowd");
+  ImGui::Checkbox("baked crowd", &this->viewer->showCrowd);
+  ImGui::SliderInt("instances", &this->viewer->crowdSize, 1, 2000);
+  ImGui::SliderInt("animated copies", &this->viewer->copies, 1, 200);
+  ImGui::Checkbox("occlusion culling", &this->viewer->occlusionCulling);
+  if (this->viewer->occlusionCulling)
+  {
+    ImGui::SliderInt("occluder copies", &this->viewer->occluderCopies, 0, 32);
+    const OcclusionStats &occlusionStats = this->viewer->occlusionCuller.getStats();
+    ImGui::Text("occluders: %zu triangles: %zu %.2f ms", occlusionStats.occluders,
+                occlusionStats.triangles, this->viewer->cullTime);
+    ImGui::Text("tested: %zu outside: %zu occluded: %zu", occlusionStats.tested,
+                occlusionStats.outside, occlusionStats.occluded);
+  }
   ImGui::End();
 
   ImGui::Render();
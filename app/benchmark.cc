@@ -0,0 +1,112 @@
+#include "benchmark.h"
+#include "../model/model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// frames skinned per measurement
+static const int benchmarkFrames = 200;
+// simd and scalar results may differ by rounding, not by more
+static const float tolerance = 1e-3f;
+
+// seconds to skin benchmarkFrames frames, advancing the animation between
+// frames so the palettes change like they would in the viewer
+static double timeSkinning(CpuSkinning &skinning, Controller &controller, int skin, int threads,
+                           std::vector<Mat4x4> &palette, std::vector<SkinnedVertex> &out)
+{
+  double seconds = 0.0;
+  for (int frame = 0; frame < benchmarkFrames; ++frame)
+  {
+    controller.update(1.0f / 60.0f);
+    controller.getPalette(skin, palette);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    skinning.skin(palette.data(), (int)palette.size(), out, threads);
+    auto end = std::chrono::high_resolution_clock::now();
+    seconds += std::chrono::duration<double>(end - start).count();
+  }
+  return seconds;
+}
+
+int benchmarkSkinning(const std::vector<std::string> &paths)
+{
+  bool matched = true;
+
+  for (std::string path : paths)
+  {
+    Model model;
+    GLTFImportSettings settings;
+    settings.upload = false;
+    settings.verbose = false;
+    try
+    {
+      GLTFFile file = GLTFFile(path, settings);
+      file.populateModel(model);
+    }
+    catch (const std::exception &e)
+    {
+      std::cout << path << ": " << e.what() << std::endl;
+      matched = false;
+      continue;
+    }
+
+    Controller *controller = model.animController;
+    if (controller == nullptr)
+    {
+      std::cout << path << ": no skeleton, nothing to skin" << std::endl;
+      continue;
+    }
+    controller->setCurrentAnimation(0);
+    controller->play();
+
+    std::cout << "\n" << path << std::endl;
+    std::vector<Mat4x4> palette;
+    std::vector<SkinnedVertex> skinned, reference;
+    for (size_t m = 0; m < model.meshes.size(); ++m)
+    {
+      const Mesh &mesh = model.meshes[m];
+      if (mesh.skin == -1)
+      {
+        continue;
+      }
+
+      CpuSkinning skinning;
+      skinning.setMesh(mesh);
+      double vertices = (double)skinning.size() * benchmarkFrames;
+
+      double single = timeSkinning(skinning, *controller, mesh.skin, 1, palette, skinned);
+      double all = timeSkinning(skinning, *controller, mesh.skin, 0, palette, skinned);
+      // small meshes run on fewer threads than the pool has
+      int threads = skinning.getThreads();
+
+      // both paths on the last palette
+      skinning.skin(palette.data(), (int)palette.size(), skinned);
+      skinning.skinReference(palette.data(), (int)palette.size(), reference);
+      float error = 0.0f;
+      for (size_t v = 0; v < reference.size(); ++v)
+      {
+        for (int i = 0; i < 3; ++i)
+        {
+          error = std::max(error, fabsf(skinned[v].pos[i] - reference[v].pos[i]));
+          error = std::max(error, fabsf(skinned[v].norm[i] - reference[v].norm[i]));
+        }
+      }
+      matched = matched && error <= tolerance;
+
+      std::cout << "  mesh " << m << ": " << skinning.size() << " vertices, "
+                << mesh.influences << " influences" << std::endl;
+      std::cout << "    1 thread: " << vertices / single / 1e6 << " M vertices/s" << std::endl;
+      std::cout << "    " << threads << (threads == 1 ? " thread: " : " threads: ") << vertices / all / 1e6
+                << " M vertices/s, " << vertices / all / threads / 1e6 << " M per thread" << std::endl;
+      std::cout << "    max error " << error << (error <= tolerance ? "" : " (too large)") << std::endl;
+    }
+
+    // Model::clean frees gl buffers, only the animation needs freeing here
+    controller->clean();
+    delete controller;
+    model.animController = nullptr;
+  }
+  return matched ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+/// @brief skins every skinned mesh of the models on the cpu, without a
+/// window or gl context, and prints the vertices skinned per second on one
+/// core and on all cores, and the largest difference to the scalar path
+/// @return 0 if every mesh matched the scalar path
+int benchmarkSkinning(const std::vector<std::string> &paths);
+
+#endif
@@ -3,6 +3,7 @@
 #include "../external/glad/glad.h"
 
 #include "window.h"
+#include "../model/renderer/glState.h"
 
 Window::Window() : win(nullptr), context(nullptr), width(800), height(600) {}
 void Window::swapBuffer() { SDL_GL_SwapWindow(this->win); }
@@ -61,8 +62,8 @@ void Window::init()
    glewInit(); */
 
   glViewport(0, 0, this->width, this->height);
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_CULL_FACE);
+  GLState::setEnabled(GL_DEPTH_TEST, true);
+  GLState::setEnabled(GL_CULL_FACE, true);
   glCullFace(GL_BACK);
   glFrontFace(GL_CCW);
 }
@@ -1,8 +1,20 @@
 #include "app/app.h"
+#include "app/benchmark.h"
+#include <cstring>
 #include <iostream>
 
-int main()
+int main(int argc, char **argv)
 {
+  // --bench-skinning [models...] measures cpu skinning without opening a window
+  if (argc > 1 && strcmp(argv[1], "--bench-skinning") == 0)
+  {
+    std::vector<std::string> paths(argv + 2, argv + argc);
+    if (paths.empty())
+    {
+      paths = {"models/zombie/scene.gltf", "models/mira/scene.gltf"};
+    }
+    return benchmarkSkinning(paths);
+  }
 
   try
   {
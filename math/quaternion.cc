@@ -25,12 +25,7 @@ Quat::Quat(float angle, Vector3f axis)
 
 float Quat::norm() const
 {
-  float x2 = std::pow(x, 2.0);
-  float y2 = std::pow(y, 2.0);
-  float z2 = std::pow(z, 2.0);
-  float s2 = std::pow(s, 2.0);
-
-  return std::sqrt(x2 + y2 + z2 + s2);
+  return std::sqrt(x * x + y * y + z * z + s * s);
 }
 
 Quat Quat::unit() const
@@ -40,6 +35,13 @@ Quat Quat::unit() const
   return Quat(x * coeff, y * coeff, z * coeff, s * coeff);
 }
 
+Quat Quat::fastUnit() const
+{
+  float coeff = inverse_sqrt(x * x + y * y + z * z + s * s);
+
+  return Quat(x * coeff, y * coeff, z * coeff, s * coeff);
+}
+
 Quat Quat::conjugate() const { return Quat(-x, -y, -z, s); }
 
 Quat Quat::inverse() const
@@ -59,6 +61,17 @@ Vector3f axis(Quat q) { return Vector3f(q.x, q.y, q.z); }
 
 Quat mix(Quat from, Quat to, float t) { return (1.0 - t) * from + t * to; }
 
+Quat nlerp(const Quat &from, const Quat &to, float t)
+{
+  float u = 1.0f - t;
+  return Quat(
+             u * from.x + t * to.x,
+             u * from.y + t * to.y,
+             u * from.z + t * to.z,
+             u * from.s + t * to.s)
+      .fastUnit();
+}
+
 Mat3x3 Quat::toMat3x3() const
 {
 
@@ -75,9 +88,9 @@ Mat4x4 Quat::toMat4x4() const
 {
   Mat4x4 result = Mat4x4();
 
-  float x2 = std::pow(x, 2.0);
-  float y2 = std::pow(y, 2.0);
-  float z2 = std::pow(z, 2.0);
+  float x2 = x * x;
+  float y2 = y * y;
+  float z2 = z * z;
   // first row
   result.xx = 1.0 - 2.0 * (y2 + z2);
   result.xy = 2.0 * (x * y - s * z);
@@ -36,6 +36,9 @@ struct Quat
 
   float norm() const;
   Quat unit() const;
+  /// @brief normalizes with an approximate reciprocal square root, for
+  /// quaternions that are already close to unit length
+  Quat fastUnit() const;
   Quat conjugate() const;
   Quat inverse() const;
 
@@ -45,6 +48,8 @@ struct Quat
 Vector3f axis(Quat q);
 float dot(const Quat &lhs, const Quat &rhs);
 Quat mix(Quat from, Quat to, float t);
+/// @brief normalized lerp, from and to must lie in the same hemisphere
+Quat nlerp(const Quat &from, const Quat &to, float t);
 
 Quat operator+(const Quat &lhs, const Quat &rhs);
 
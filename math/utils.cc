@@ -1,5 +1,9 @@
 #include "utils.h"
 
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
 float to_radians(float degs)
 {
   float radian = PIE / 180.0f;
@@ -56,4 +60,15 @@ T clamp(T v, T min, T max)
   // return std::max(min, std::min(max, v));
 }
 template float clamp<float>(float v, float min, float max);
-template int clamp<int>(int v, int min, int max);
\ No newline at end of file
+template int clamp<int>(int v, int min, int max);
+
+float inverse_sqrt(float value)
+{
+#if defined(__SSE__) || defined(_M_X64)
+  // hardware estimate refined with one newton-raphson step
+  float estimate = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(value)));
+  return estimate * (1.5f - 0.5f * value * estimate * estimate);
+#else
+  return 1.0f / sqrtf(value);
+#endif
+}
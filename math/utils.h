@@ -17,6 +17,8 @@ float max(float a, float b);
 float min(float a, float b);
 int step(float edge, float b);
 float fract(float value);
+// approximate 1 / sqrt(value), relative error below 1e-6
+float inverse_sqrt(float value);
 // limits a value to the range min - max
 template <class T>
 T clamp(T v, T min, T max);
@@ -1,7 +1,10 @@
 #include "clip.h"
 #include "frame.h"
 #include "pose.h"
+#include "timeline.h"
 #include "track.h"
 #include "skeleton.h"
 #include "transformTrack.h"
+#include "compressedTrack.h"
+#include "bakedClip.h"
 #include "controller.h"
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "bakedClip.h"
+#include "clip.h"
+#include "pose.h"
+#include "transformTrack.h"
+#include "compressedTrack.h"
+#include <algorithm>
+#include <cmath>
+
+void BakedClip::bake(Clip &clip, Pose &refPose, float rate)
+{
+  this->startTime = clip.GetStartTime();
+  this->joints = clip.getAnimatedJoints();
+  this->frames.clear();
+
+  float duration = clip.GetDuration();
+  unsigned int intervals = (unsigned int)std::max(1.0f, ceilf(duration * rate));
+  this->frameCount = intervals + 1;
+  this->rate = duration > 0.0f ? (float)intervals / duration : 0.0f;
+
+  size_t jointCount = this->joints.size();
+  this->frames.resize(jointCount * this->frameCount);
+
+  // a looping clip wraps its end time back to the first key, clamp instead
+  // so the last sample holds the last key
+  bool looping = clip.GetLooping();
+  clip.SetLooping(false);
+
+  Pose pose = refPose;
+  for (unsigned int i = 0; i < this->frameCount; ++i)
+  {
+    float time = this->startTime + (float)i / (float)intervals * duration;
+    clip.sample(pose, time);
+
+    for (size_t j = 0; j < jointCount; ++j)
+    {
+      Transform local = pose.getLocalTransform(this->joints[j]);
+
+      // keep neighbouring samples in the same hemisphere so sampling can
+      // blend rotations without a sign check
+      if (i > 0)
+      {
+        Quat &previous = this->frames[j * this->frameCount + i - 1].orientation;
+        if (dot(previous, local.orientation) < 0.0f)
+        {
+          local.orientation = -1.0f * local.orientation;
+        }
+      }
+      this->frames[j * this->frameCount + i] = local;
+    }
+  }
+
+  clip.SetLooping(looping);
+}
+
+void BakedClip::sample(Pose &outPose, float time)
+{
+  if (this->frameCount < 2)
+  {
+    return;
+  }
+
+  float position = std::max(0.0f, (time - this->startTime) * this->rate);
+  unsigned int frame = std::min((unsigned int)position, this->frameCount - 2);
+  float t = std::min(position - (float)frame, 1.0f);
+
+  size_t jointCount = this->joints.size();
+  for (size_t j = 0; j < jointCount; ++j)
+  {
+    const Transform &a = this->frames[j * this->frameCount + frame];
+    const Transform &b = this->frames[j * this->frameCount + frame + 1];
+
+    Transform result;
+    result.translation = lerp(a.translation, b.translation, t);
+    result.orientation = mix(a.orientation, b.orientation, t).unit();
+    result.scaling = lerp(a.scaling, b.scaling, t);
+    outPose.setLocalTransform(this->joints[j], result);
+  }
+}
+
+unsigned int BakedClip::getFrameCount() { return this->frameCount; }
+float BakedClip::getRate() { return this->rate; }
+
+size_t BakedClip::memory()
+{
+  return this->frames.size() * sizeof(Transform) +
+         this->joints.size() * sizeof(unsigned int);
+}
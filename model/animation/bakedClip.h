@@ -0,0 +1,40 @@
+#ifndef BAKEDCLIP_H
+#define BAKEDCLIP_H
+
+#include <vector>
+#include "../../math/transform.h"
+
+/// @brief clip resampled at a fixed rate. every animated joint stores one
+/// transform per sample in a contiguous array, so sampling is a multiply to
+/// find the frame and one blend weight shared by all joints, no key search.
+class BakedClip
+{
+public:
+  BakedClip() : startTime(0.0f), rate(0.0f), frameCount(0) {}
+  ~BakedClip() {}
+
+  /// @brief resamples clip at roughly rate samples per second. the rate is
+  /// adjusted so the first and last samples land on the clip's start and end
+  /// @param clip source clip, sampled through its current representation
+  /// @param refPose pose the clip is sampled on top of
+  void bake(class Clip &clip, class Pose &refPose, float rate);
+
+  /// @brief writes the baked transforms of the animated joints to outPose
+  /// @param time clip time, already wrapped or clamped to the clip's range
+  void sample(class Pose &outPose, float time);
+
+  unsigned int getFrameCount();
+  float getRate();
+  size_t memory();
+
+private:
+  float startTime;
+  float rate;
+  unsigned int frameCount;
+  // joint targeted by each baked array
+  std::vector<unsigned int> joints;
+  // frameCount transforms per joint, joint after joint
+  std::vector<Transform> frames;
+};
+
+#endif
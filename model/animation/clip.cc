@@ -2,8 +2,15 @@
 #include "../../math/transform.h"
 #include "pose.h"
 #include "transformTrack.h"
+#include "compressedTrack.h"
+#include "bakedClip.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
 
-Clip::Clip() : name("none"), startTime(0.0), endTime(0.0), looping(true) {}
+Clip::Clip()
+    : name("none"), startTime(0.0), endTime(0.0), looping(true),
+      compressed(false) {}
 
 float Clip::sample(Pose &outPose, float inTime)
 {
@@ -15,12 +22,36 @@ float Clip::sample(Pose &outPose, float inTime)
   float time = inTime;
   time = this->adjustTimeToFitRange(time);
 
+  if (this->baked != nullptr)
+  {
+    this->baked->sample(outPose, time);
+    return time;
+  }
+
+  // one key search per timeline serves every channel keyed on it
+  this->lookups.resize(this->timelines.size());
+  for (size_t i = 0; i < this->timelines.size(); ++i)
+  {
+    this->lookups[i] = this->timelines[i]->lookup(time, this->looping);
+  }
+
+  if (this->compressed)
+  {
+    for (auto &track : this->compressedTracks)
+    {
+      size_t j = track.getId();
+      Transform local = outPose.getLocalTransform(j);
+      outPose.setLocalTransform(j, track.sample(local, this->lookups));
+    }
+    return time;
+  }
+
   uint size = this->tracks.size();
   for (uint i = 0; i < size; ++i)
   {
     uint j = (uint)this->tracks[i].getId();
     Transform local = outPose.getLocalTransform((size_t)j);
-    Transform animated = this->tracks[i].sample(local, time, this->looping);
+    Transform animated = this->tracks[i].sample(local, this->lookups);
     outPose.setLocalTransform((size_t)j, animated);
   }
   return time;
@@ -37,7 +68,7 @@ float Clip::adjustTimeToFitRange(float time)
     }
     time = fmodf(time - this->startTime, duration);
 
-    if (time <= 0.0)
+    if (time < 0.0)
     {
       time += duration;
     }
@@ -84,6 +115,307 @@ void Clip::ReCalculateDuartion()
   }
 }
 
+ClipOptimizeReport Clip::optimize(Pose &restPose)
+{
+  this->basePose = restPose;
+
+  ClipOptimizeReport report;
+  report.tracks = this->tracks.size();
+  std::vector<TransformTrack> animated;
+  animated.reserve(this->tracks.size());
+  for (auto &track : this->tracks)
+  {
+    size_t id = track.getId();
+    if (id >= this->basePose.size())
+    {
+      std::cout << "track targets joint (" << id << ") outside of the skeleton\n";
+      continue;
+    }
+
+    Transform base = this->basePose.getLocalTransform(id);
+    report.folded += track.foldConstants(base);
+    this->basePose.setLocalTransform(id, base);
+
+    if (track.isValid())
+    {
+      track.precondition();
+      animated.push_back(track);
+    }
+  }
+
+  report.animated = animated.size();
+
+  this->tracks = animated;
+  this->shareTimelines();
+  return report;
+}
+
+void Clip::shareTimelines()
+{
+  std::vector<std::shared_ptr<Timeline>> shared;
+
+  auto share = [&shared](std::shared_ptr<Timeline> &timeline, unsigned int &index)
+  {
+    if (timeline == nullptr)
+    {
+      return;
+    }
+    for (size_t i = 0; i < shared.size(); ++i)
+    {
+      if (shared[i] == timeline || shared[i]->times == timeline->times)
+      {
+        timeline = shared[i];
+        index = (unsigned int)i;
+        return;
+      }
+    }
+    index = (unsigned int)shared.size();
+    shared.push_back(timeline);
+  };
+
+  for (auto &track : this->tracks)
+  {
+    VectorTrack &position = track.getPosTrack();
+    QuatTrack &rotation = track.getRotationTrack();
+    VectorTrack &scaling = track.getScalingTrack();
+    share(position.timeline, position.timelineIndex);
+    share(rotation.timeline, rotation.timelineIndex);
+    share(scaling.timeline, scaling.timelineIndex);
+  }
+
+  this->timelines = shared;
+}
+
+size_t Clip::timelineCount() { return this->timelines.size(); }
+
+Pose &Clip::getBasePose() { return this->basePose; }
+
+KeyReductionReport Clip::reduce(Pose &restPose, float tolerance)
+{
+  KeyReductionReport report;
+  size_t jointCount = restPose.size();
+
+  std::vector<Vector3f> positions(jointCount);
+  for (size_t i = 0; i < jointCount; ++i)
+  {
+    positions[i] = restPose.getGlobalTransform(i).translation;
+  }
+
+  // lever arm of every joint: the distance to the furthest joint it moves
+  std::vector<float> reach(jointCount, 0.0f);
+  float boneLengths = 0.0f;
+  int bones = 0;
+  int maxDepth = 1;
+  for (size_t i = 0; i < jointCount; ++i)
+  {
+    int depth = 1;
+    int p = restPose.getParent(i);
+    if (p != -1)
+    {
+      boneLengths += (positions[i] - positions[p]).mag();
+      bones++;
+    }
+    while (p != -1)
+    {
+      reach[p] = std::max(reach[p], (positions[i] - positions[p]).mag());
+      p = restPose.getParent(p);
+      depth++;
+    }
+    maxDepth = std::max(maxDepth, depth);
+  }
+  // end joints still move the skin around them
+  float minReach = bones > 0 ? boneLengths / (float)bones : 1.0f;
+  minReach = std::max(minReach, 1e-4f);
+
+  // errors of every joint on a chain add up, split the budget between them
+  float share = tolerance / (float)maxDepth;
+
+  this->shareTimelines();
+  Clip source = *this;
+
+  // channels keyed on one timeline drop the same keys so they keep sharing
+  // it and its lookup. a key goes only if every channel can do without it
+  struct Channel
+  {
+    std::function<bool(size_t, size_t)> canSpan;
+    std::function<void(const std::vector<size_t> &, std::shared_ptr<Timeline>)> keepFrames;
+  };
+  std::vector<std::vector<Channel>> channels(this->timelines.size());
+  auto addChannel = [&channels](auto &track, float channelTolerance)
+  {
+    if (track.timeline == nullptr || track.timelineIndex >= channels.size())
+    {
+      return;
+    }
+    channels[track.timelineIndex].push_back(
+        {[&track, channelTolerance](size_t first, size_t last)
+         { return track.canSpan(first, last, channelTolerance); },
+         [&track](const std::vector<size_t> &keep, std::shared_ptr<Timeline> times)
+         { track.keepFrames(keep, times); }});
+  };
+
+  for (auto &track : this->tracks)
+  {
+    report.keysBefore += track.keyCount();
+    size_t id = track.getId();
+    if (id >= jointCount)
+    {
+      continue;
+    }
+
+    float lever = std::max(reach[id], minReach);
+    addChannel(track.getPosTrack(), share);
+    addChannel(track.getRotationTrack(), share / lever);
+    addChannel(track.getScalingTrack(), share / lever);
+  }
+
+  for (size_t t = 0; t < this->timelines.size(); ++t)
+  {
+    const std::vector<float> &times = this->timelines[t]->times;
+    size_t count = times.size();
+    if (count < 3 || channels[t].empty())
+    {
+      continue;
+    }
+
+    // grow each span until a key in between can no longer be reconstructed
+    // by one of the channels
+    std::vector<size_t> keep = {0};
+    size_t anchor = 0;
+    for (size_t i = 2; i < count; ++i)
+    {
+      bool spans = true;
+      for (auto &channel : channels[t])
+      {
+        if (!channel.canSpan(anchor, i))
+        {
+          spans = false;
+          break;
+        }
+      }
+      if (!spans)
+      {
+        keep.push_back(i - 1);
+        anchor = i - 1;
+      }
+    }
+    keep.push_back(count - 1);
+
+    if (keep.size() == count)
+    {
+      continue;
+    }
+    std::shared_ptr<Timeline> kept = std::make_shared<Timeline>();
+    for (size_t index : keep)
+    {
+      kept->times.push_back(times[index]);
+    }
+    for (auto &channel : channels[t])
+    {
+      channel.keepFrames(keep, kept);
+    }
+  }
+
+  for (auto &track : this->tracks)
+  {
+    report.keysAfter += track.keyCount();
+  }
+
+  // compare model space joint positions at every source key time
+  this->shareTimelines();
+
+  std::vector<float> times;
+  for (auto &timeline : source.timelines)
+  {
+    times.insert(times.end(), timeline->times.begin(), timeline->times.end());
+  }
+  std::sort(times.begin(), times.end());
+  times.erase(std::unique(times.begin(), times.end()), times.end());
+
+  Pose expected = restPose;
+  Pose reduced = restPose;
+  for (float time : times)
+  {
+    source.sample(expected, time);
+    this->sample(reduced, time);
+    for (size_t i = 0; i < jointCount; ++i)
+    {
+      Vector3f a = expected.getGlobalTransform(i).translation;
+      Vector3f b = reduced.getGlobalTransform(i).translation;
+      report.maxErrorAfter = std::max(report.maxErrorAfter, (a - b).mag());
+    }
+  }
+
+  return report;
+}
+
+ClipMemoryReport Clip::compress(const CompressionSettings &settings)
+{
+  ClipMemoryReport report;
+
+  this->compressedTracks.resize(this->tracks.size());
+  for (size_t i = 0; i < this->tracks.size(); ++i)
+  {
+    this->compressedTracks[i].compress(this->tracks[i], settings, report);
+  }
+
+  // timelines are shared by both representations
+  for (auto &timeline : this->timelines)
+  {
+    size_t bytes = timeline->times.size() * sizeof(float);
+    report.rawBytes += bytes;
+    report.compressedBytes += bytes;
+  }
+
+  this->tracks.clear();
+  this->tracks.shrink_to_fit();
+  this->compressed = true;
+
+  return report;
+}
+
+bool Clip::isCompressed() { return this->compressed; }
+
+size_t Clip::bake(Pose &restPose, float rate)
+{
+  Pose &ref = this->basePose.size() == restPose.size() ? this->basePose : restPose;
+
+  std::shared_ptr<BakedClip> result = std::make_shared<BakedClip>();
+  result->bake(*this, ref, rate);
+  this->baked = result;
+
+  this->tracks.clear();
+  this->tracks.shrink_to_fit();
+  this->compressedTracks.clear();
+  this->compressedTracks.shrink_to_fit();
+  this->timelines.clear();
+  this->compressed = false;
+
+  return result->memory();
+}
+
+bool Clip::isBaked() { return this->baked != nullptr; }
+
+std::vector<unsigned int> Clip::getAnimatedJoints()
+{
+  std::vector<unsigned int> result;
+  if (this->compressed)
+  {
+    for (auto &track : this->compressedTracks)
+    {
+      result.push_back((unsigned int)track.getId());
+    }
+  }
+  else
+  {
+    for (auto &track : this->tracks)
+    {
+      result.push_back((unsigned int)track.getId());
+    }
+  }
+  return result;
+}
+
 TransformTrack &Clip::getTrack(size_t index)
 {
   return this->tracks[index];
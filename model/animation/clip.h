@@ -3,6 +3,28 @@
 
 #include <vector>
 #include <string>
+#include "pose.h"
+#include "timeline.h"
+#include <memory>
+
+/// @brief key counts and the largest joint position error (model space)
+/// measured at the source key times after key reduction. the source clip
+/// is the reference, so there is no error before reduction to report
+struct KeyReductionReport
+{
+  size_t keysBefore{0};
+  size_t keysAfter{0};
+  float maxErrorAfter{0.0f};
+};
+
+/// @brief tracks left animated and channels folded into the base pose by
+/// Clip::optimize
+struct ClipOptimizeReport
+{
+  size_t tracks{0};
+  size_t animated{0};
+  size_t folded{0};
+};
 
 class Clip
 {
@@ -14,6 +36,8 @@ public:
   void setIdAtIndex(uint idx, uint id);
   uint size();
   float sample(class Pose &outPose, float inTime);
+  /// @brief wraps time into the clip when looping, clamps it otherwise
+  float adjustTimeToFitRange(float time);
   void ReCalculateDuartion();
 
   std::string &GetName();
@@ -26,6 +50,47 @@ public:
 
   void resize(size_t newSize);
 
+  /// @brief folds constant channels and joints without tracks into a base
+  /// pose, dropping them from the clip so sampling only touches animated
+  /// channels, then preconditions the remaining tracks for sampling. the
+  /// clip duration is left untouched.
+  /// @param restPose rest pose of the skeleton the clip plays on
+  ClipOptimizeReport optimize(Pose &restPose);
+  /// @brief rest pose with the clip's constant channels applied, empty if
+  /// the clip has not been optimized
+  Pose &getBasePose();
+
+  /// @brief removes keys that can be reconstructed by interpolation. each
+  /// joint gets a share of the tolerance scaled by the distance to the
+  /// joints below it, so errors propagated down the hierarchy stay bounded.
+  /// keys are dropped per timeline, only where every channel on it can do
+  /// without them, so the channels keep sharing their timeline.
+  /// @param restPose rest pose of the skeleton the clip plays on
+  /// @param tolerance max joint position error in model units
+  KeyReductionReport reduce(Pose &restPose, float tolerance);
+
+  /// @brief quantizes the clip's keyframes and releases the float keys,
+  /// channels over the error budget stay uncompressed
+  /// @return memory used by the keys before and after
+  struct ClipMemoryReport compress(const struct CompressionSettings &settings);
+  bool isCompressed();
+
+  /// @brief resamples the clip at a fixed rate and releases its keys, see
+  /// BakedClip. costs more memory than keys but samples without key searches
+  /// @param restPose rest pose of the skeleton the clip plays on
+  /// @param rate samples per second
+  /// @return bytes used by the baked samples
+  size_t bake(Pose &restPose, float rate);
+  bool isBaked();
+
+  /// @brief joints written by sample
+  std::vector<unsigned int> getAnimatedJoints();
+
+  /// @brief deduplicates the key times of all tracks so tracks keyed at the
+  /// same times share one timeline, and indexes them for sampling
+  void shareTimelines();
+  size_t timelineCount();
+
   class TransformTrack &getTrack(size_t index);
  std::vector<class TransformTrack> &getTracks();
 
@@ -35,8 +100,14 @@ private:
   float endTime;
   bool looping;
   std::vector<class TransformTrack> tracks;
+  std::vector<std::shared_ptr<Timeline>> timelines;
+  // scratch space for the per timeline key lookups of a sample
+  std::vector<KeyLookup> lookups;
+  Pose basePose;
+  std::vector<class CompressedTransformTrack> compressedTracks;
+  bool compressed;
+  std::shared_ptr<class BakedClip> baked;
 
-  float adjustTimeToFitRange(float time);
 };
 
 #endif
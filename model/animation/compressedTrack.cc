@@ -0,0 +1,400 @@
+#include "compressedTrack.h"
+#include "../../math/transform.h"
+#include <algorithm>
+
+namespace
+{
+  // the three smallest components of a unit quaternion lie within +-1/sqrt(2)
+  const float SMALLEST_THREE_RANGE = 0.70710678f;
+  const float MAX_15BIT = 32767.0f;
+  const float MAX_16BIT = 65535.0f;
+
+  uint16_t quantize(float value, float min, float extent, float steps)
+  {
+    if (extent <= 0.0f)
+    {
+      return 0;
+    }
+    float normalized = clamp((value - min) / extent, 0.0f, 1.0f);
+    return (uint16_t)(normalized * steps + 0.5f);
+  }
+
+  float dequantize(uint16_t value, float min, float extent, float steps)
+  {
+    return min + extent * ((float)value / steps);
+  }
+
+  void packQuat(Quat q, uint16_t *out)
+  {
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+    {
+      if (fabsf(q.v[i]) > fabsf(q.v[largest]))
+      {
+        largest = i;
+      }
+    }
+    // q and -q are the same rotation, keep the dropped component positive
+    // and remember the sign in the spare bit
+    uint64_t negative = q.v[largest] < 0.0f ? 1 : 0;
+    if (negative)
+    {
+      q = -1.0f * q;
+    }
+
+    uint64_t bits = (negative << 47) | ((uint64_t)largest << 45);
+    int shift = 30;
+    for (int i = 0; i < 4; ++i)
+    {
+      if (i == largest)
+      {
+        continue;
+      }
+      uint64_t component = quantize(q.v[i], -SMALLEST_THREE_RANGE,
+                                    2.0f * SMALLEST_THREE_RANGE, MAX_15BIT);
+      bits |= component << shift;
+      shift -= 15;
+    }
+
+    out[0] = (uint16_t)(bits & 0xffff);
+    out[1] = (uint16_t)((bits >> 16) & 0xffff);
+    out[2] = (uint16_t)((bits >> 32) & 0xffff);
+  }
+
+  Quat unpackQuat(const uint16_t *in)
+  {
+    uint64_t bits = (uint64_t)in[0] | ((uint64_t)in[1] << 16) | ((uint64_t)in[2] << 32);
+    int largest = (int)((bits >> 45) & 0x3);
+
+    Quat result = Quat(0.0f);
+    float sum = 0.0f;
+    int shift = 30;
+    for (int i = 0; i < 4; ++i)
+    {
+      if (i == largest)
+      {
+        continue;
+      }
+      uint16_t component = (uint16_t)((bits >> shift) & 0x7fff);
+      result.v[i] = dequantize(component, -SMALLEST_THREE_RANGE,
+                               2.0f * SMALLEST_THREE_RANGE, MAX_15BIT);
+      sum += result.v[i] * result.v[i];
+      shift -= 15;
+    }
+    result.v[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+
+    if ((bits >> 47) & 0x1)
+    {
+      result = -1.0f * result;
+    }
+    return result;
+  }
+
+  template <size_t N>
+  void valueRange(const float *values, size_t stride, size_t count,
+                  float *min, float *extent)
+  {
+    for (size_t j = 0; j < N; ++j)
+    {
+      float lo = values[j];
+      float hi = values[j];
+      for (size_t i = 1; i < count; ++i)
+      {
+        lo = std::min(lo, values[i * stride + j]);
+        hi = std::max(hi, values[i * stride + j]);
+      }
+      min[j] = lo;
+      extent[j] = hi - lo;
+    }
+  }
+
+  float keyError(const Vector3f &a, const Vector3f &b) { return (a - b).mag(); }
+  float keyError(const Quat &a, const Quat &b)
+  {
+    Quat other = dot(a, b) < 0.0f ? -1.0f * b : b;
+    float error = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+      error = std::max(error, fabsf(a.v[i] - other.v[i]));
+    }
+    return error;
+  }
+} // namespace
+
+template <typename T, size_t N>
+float CompressedTrack<T, N>::compress(Track<T, N> &track)
+{
+  size_t count = track.frames.size();
+  this->interpolation = track.interpolation;
+  this->preconditioned = track.preconditioned;
+  this->timeline = track.timeline;
+  this->timelineIndex = track.timelineIndex;
+  this->keys.resize(count * 3);
+  this->tangents.clear();
+
+  if (count == 0)
+  {
+    return 0.0f;
+  }
+
+  const size_t stride = sizeof(Frame<N>) / sizeof(float);
+  if (N != 4)
+  {
+    valueRange<N>(&track.frames[0].m_value[0], stride, count,
+                  this->keyMin, this->keyExtent);
+  }
+
+  bool cubic = this->interpolation == Interpolation::Cubic;
+  if (cubic)
+  {
+    float inMin[N], inExtent[N], outMin[N], outExtent[N];
+    valueRange<N>(&track.frames[0].m_in[0], stride, count, inMin, inExtent);
+    valueRange<N>(&track.frames[0].m_out[0], stride, count, outMin, outExtent);
+    for (size_t j = 0; j < N; ++j)
+    {
+      this->tangentMin[j] = std::min(inMin[j], outMin[j]);
+      float max = std::max(inMin[j] + inExtent[j], outMin[j] + outExtent[j]);
+      this->tangentExtent[j] = max - this->tangentMin[j];
+    }
+    this->tangents.resize(count * 2 * N);
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    Frame<N> &frame = track.frames[i];
+
+    if (N == 4)
+    {
+      packQuat(Quat(frame.m_value[0], frame.m_value[1], frame.m_value[2], frame.m_value[3]).unit(),
+               &this->keys[i * 3]);
+    }
+    else
+    {
+      for (size_t j = 0; j < N; ++j)
+      {
+        this->keys[i * 3 + j] = quantize(frame.m_value[j], this->keyMin[j],
+                                         this->keyExtent[j], MAX_16BIT);
+      }
+    }
+
+    if (cubic)
+    {
+      for (size_t j = 0; j < N; ++j)
+      {
+        this->tangents[i * 2 * N + j] = quantize(
+            frame.m_in[j], this->tangentMin[j], this->tangentExtent[j], MAX_16BIT);
+        this->tangents[i * 2 * N + N + j] = quantize(
+            frame.m_out[j], this->tangentMin[j], this->tangentExtent[j], MAX_16BIT);
+      }
+    }
+  }
+
+  float error = 0.0f;
+  for (size_t i = 0; i < count; ++i)
+  {
+    error = std::max(error, keyError(track.getValue(i), this->getKey(i)));
+    if (cubic)
+    {
+      for (size_t j = 0; j < N; ++j)
+      {
+        float in = dequantize(this->tangents[i * 2 * N + j], this->tangentMin[j],
+                              this->tangentExtent[j], MAX_16BIT);
+        float out = dequantize(this->tangents[i * 2 * N + N + j], this->tangentMin[j],
+                               this->tangentExtent[j], MAX_16BIT);
+        error = std::max(error, fabsf(in - track.frames[i].m_in[j]));
+        error = std::max(error, fabsf(out - track.frames[i].m_out[j]));
+      }
+    }
+  }
+
+  return error;
+}
+
+template <typename T, size_t N>
+unsigned int CompressedTrack<T, N>::size()
+{
+  return (unsigned int)(this->keys.size() / 3);
+}
+
+template <typename T, size_t N>
+size_t CompressedTrack<T, N>::memory()
+{
+  return this->keys.size() * sizeof(uint16_t) +
+         this->tangents.size() * sizeof(uint16_t) +
+         sizeof(this->keyMin) + sizeof(this->keyExtent) +
+         sizeof(this->tangentMin) + sizeof(this->tangentExtent);
+}
+
+template <>
+Vector3f CompressedTrack<Vector3f, 3>::getKey(size_t index)
+{
+  const uint16_t *key = &this->keys[index * 3];
+  return Vector3f(
+      dequantize(key[0], this->keyMin[0], this->keyExtent[0], MAX_16BIT),
+      dequantize(key[1], this->keyMin[1], this->keyExtent[1], MAX_16BIT),
+      dequantize(key[2], this->keyMin[2], this->keyExtent[2], MAX_16BIT));
+}
+template <>
+Quat CompressedTrack<Quat, 4>::getKey(size_t index)
+{
+  return unpackQuat(&this->keys[index * 3]);
+}
+
+template <typename T, size_t N>
+T CompressedTrack<T, N>::getTangent(size_t index, bool out)
+{
+  T result;
+  const uint16_t *tangent = &this->tangents[index * 2 * N + (out ? N : 0)];
+  for (size_t j = 0; j < N; ++j)
+  {
+    result.v[j] = dequantize(tangent[j], this->tangentMin[j],
+                             this->tangentExtent[j], MAX_16BIT);
+  }
+  return result;
+}
+
+template <typename T, size_t N>
+T CompressedTrack<T, N>::sample(float time, bool looping)
+{
+  return this->sample(this->timeline->lookup(time, looping));
+}
+
+template <typename T, size_t N>
+T CompressedTrack<T, N>::sample(const KeyLookup &key)
+{
+  if (this->interpolation == Interpolation::Constant)
+  {
+    return this->getKey(key.frame);
+  }
+
+  T start = this->getKey(key.frame);
+  T end = this->getKey(key.next);
+
+  if (this->interpolation == Interpolation::Linear)
+  {
+    if (this->preconditioned)
+    {
+      return TrackHelpers::interpolateAligned(start, end, key.t);
+    }
+    return TrackHelpers::interpolate(start, end, key.t);
+  }
+
+  if (this->preconditioned)
+  {
+    T result = TrackHelpers::hermiteAligned(key.t, start, this->getTangent(key.frame, true),
+                                            end, this->getTangent(key.next, false));
+    return TrackHelpers::AdjustAlignedResult(result);
+  }
+
+  float frameDelta = this->timeline->times[key.next] - this->timeline->times[key.frame];
+  T slope1 = this->getTangent(key.frame, true) * frameDelta;
+  T slope2 = this->getTangent(key.next, false) * frameDelta;
+  return TrackHelpers::hermite(key.t, start, slope1, end, slope2);
+}
+
+void CompressedTransformTrack::compress(TransformTrack &track,
+                                        const CompressionSettings &settings,
+                                        ClipMemoryReport &report)
+{
+  this->id = track.getId();
+
+  VectorTrack &position = track.getPosTrack();
+  if (position.size() > 1)
+  {
+    report.keys += position.size();
+    report.rawBytes += position.size() * sizeof(Frame<3>);
+    float error = this->position.compress(position);
+    if (error <= settings.positionError)
+    {
+      report.maxPositionError = std::max(report.maxPositionError, error);
+      report.compressedBytes += this->position.memory();
+    }
+    else
+    {
+      this->position = CompressedVectorTrack();
+      this->rawPosition = position;
+      report.compressedBytes += position.size() * sizeof(Frame<3>);
+      report.fallbackChannels++;
+    }
+  }
+
+  QuatTrack &rotation = track.getRotationTrack();
+  if (rotation.size() > 1)
+  {
+    report.keys += rotation.size();
+    report.rawBytes += rotation.size() * sizeof(Frame<4>);
+    float error = this->rotation.compress(rotation);
+    if (error <= settings.rotationError)
+    {
+      report.maxRotationError = std::max(report.maxRotationError, error);
+      report.compressedBytes += this->rotation.memory();
+    }
+    else
+    {
+      this->rotation = CompressedQuatTrack();
+      this->rawRotation = rotation;
+      report.compressedBytes += rotation.size() * sizeof(Frame<4>);
+      report.fallbackChannels++;
+    }
+  }
+
+  VectorTrack &scaling = track.getScalingTrack();
+  if (scaling.size() > 1)
+  {
+    report.keys += scaling.size();
+    report.rawBytes += scaling.size() * sizeof(Frame<3>);
+    float error = this->scaling.compress(scaling);
+    if (error <= settings.scaleError)
+    {
+      report.maxScaleError = std::max(report.maxScaleError, error);
+      report.compressedBytes += this->scaling.memory();
+    }
+    else
+    {
+      this->scaling = CompressedVectorTrack();
+      this->rawScaling = scaling;
+      report.compressedBytes += scaling.size() * sizeof(Frame<3>);
+      report.fallbackChannels++;
+    }
+  }
+}
+
+template class CompressedTrack<Vector3f, 3>;
+template class CompressedTrack<Quat, 4>;
+
+size_t CompressedTransformTrack::getId() { return this->id; }
+
+Transform CompressedTransformTrack::sample(const Transform &ref,
+                                           const std::vector<KeyLookup> &lookups)
+{
+  Transform result = ref;
+
+  if (this->position.size() > 1)
+  {
+    result.translation = this->position.sample(lookups[this->position.timelineIndex]);
+  }
+  else if (this->rawPosition.size() > 1)
+  {
+    result.translation = this->rawPosition.sample(lookups[this->rawPosition.timelineIndex]);
+  }
+
+  if (this->rotation.size() > 1)
+  {
+    result.orientation = this->rotation.sample(lookups[this->rotation.timelineIndex]);
+  }
+  else if (this->rawRotation.size() > 1)
+  {
+    result.orientation = this->rawRotation.sample(lookups[this->rawRotation.timelineIndex]);
+  }
+
+  if (this->scaling.size() > 1)
+  {
+    result.scaling = this->scaling.sample(lookups[this->scaling.timelineIndex]);
+  }
+  else if (this->rawScaling.size() > 1)
+  {
+    result.scaling = this->rawScaling.sample(lookups[this->rawScaling.timelineIndex]);
+  }
+
+  return result;
+}
@@ -0,0 +1,106 @@
+#ifndef COMPRESSEDTRACK_H
+#define COMPRESSEDTRACK_H
+
+#include "track.h"
+#include "transformTrack.h"
+#include <cstdint>
+#include <vector>
+
+/// @brief error budget used when quantizing clips. a channel whose quantized
+/// keys stray further than this from the source keys is kept as floats
+struct CompressionSettings
+{
+  // max translation error in model units
+  float positionError{1e-3f};
+  // max error of any quaternion component
+  float rotationError{1e-3f};
+  // max scaling error
+  float scaleError{1e-3f};
+};
+
+/// @brief memory used by a clip before and after compression
+struct ClipMemoryReport
+{
+  size_t keys{0};
+  size_t rawBytes{0};
+  size_t compressedBytes{0};
+  // channels that went over the error budget and were left as floats
+  size_t fallbackChannels{0};
+  float maxPositionError{0.0f};
+  float maxRotationError{0.0f};
+  float maxScaleError{0.0f};
+};
+
+/// @brief keyframes packed into 3 16 bit words each. quaternions use the
+/// smallest-three encoding (2 bit index + 3 x 15 bits + sign of the dropped
+/// component, so hemisphere aligned keys stay aligned), vectors are quantized
+/// to the track's value range. tangents are only stored for cubic tracks.
+/// @tparam N track type (3=vector track, 4=quaternion track)
+template <typename T, size_t N>
+class CompressedTrack
+{
+public:
+  CompressedTrack() : timelineIndex(0), interpolation(Linear), preconditioned(false) {}
+  ~CompressedTrack() {}
+
+  // key times, shared with the source track
+  std::shared_ptr<Timeline> timeline;
+  unsigned int timelineIndex;
+  // 3 words per key
+  std::vector<uint16_t> keys;
+  // 2 * N words per key (in then out), empty unless cubic
+  std::vector<uint16_t> tangents;
+  Interpolation interpolation;
+  // copied from the source track, see Track::preconditioned
+  bool preconditioned;
+
+  /// @brief quantizes the keys of track
+  /// @return largest error between the source and quantized keys
+  float compress(Track<T, N> &track);
+
+  unsigned int size();
+  size_t memory();
+
+  T sample(float time, bool looping);
+  T sample(const KeyLookup &key);
+
+private:
+  float keyMin[N]{};
+  float keyExtent[N]{};
+  float tangentMin[N]{};
+  float tangentExtent[N]{};
+
+  T getKey(size_t index);
+  T getTangent(size_t index, bool out);
+};
+
+typedef CompressedTrack<Vector3f, 3> CompressedVectorTrack;
+typedef CompressedTrack<Quat, 4> CompressedQuatTrack;
+
+/// @brief compressed counterpart of TransformTrack, channels over the error
+/// budget keep their float keys
+class CompressedTransformTrack
+{
+public:
+  CompressedTransformTrack() : id(0) {}
+  ~CompressedTransformTrack() {}
+
+  void compress(TransformTrack &track, const CompressionSettings &settings,
+                ClipMemoryReport &report);
+
+  size_t getId();
+  Transform sample(const Transform &ref, const std::vector<KeyLookup> &lookups);
+
+private:
+  CompressedVectorTrack position;
+  CompressedQuatTrack rotation;
+  CompressedVectorTrack scaling;
+
+  VectorTrack rawPosition;
+  QuatTrack rawRotation;
+  VectorTrack rawScaling;
+
+  size_t id;
+};
+
+#endif
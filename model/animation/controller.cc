@@ -3,6 +3,8 @@
 #include "pose.h"
 #include "skeleton.h"
 #include "transformTrack.h"
+#include "compressedTrack.h"
+#include <algorithm>
 #include <iostream>
 
 void Controller::addClip(Clip *clip)
@@ -14,6 +16,21 @@ void Controller::removeClip(size_t index)
   if (index < this->clips.size())
   {
     this->clips.erase(this->clips.begin() + index);
+    this->poseDirty = true;
+    this->fading = false;
+
+    // layers keep playing the clips they were given
+    for (size_t i = this->layers.size(); i-- > 0;)
+    {
+      if (this->layers[i].clip == index)
+      {
+        this->removeLayer(i);
+      }
+      else if (this->layers[i].clip > index)
+      {
+        this->layers[i].clip--;
+      }
+    }
   }
   else
   {
@@ -26,10 +43,18 @@ void Controller::setSkeleton(Skeleton *skeleton)
   this->skeleton = skeleton;
   if (this->outPose == nullptr)
   {
-    this->outPose = new Pose(skeleton->restPose.size());
+    this->outPose = new Pose(skeleton->restPose);
+    this->fadePose = new Pose(skeleton->restPose);
+    this->blendPose = new Pose(skeleton->restPose);
+    this->finalPose = this->outPose;
   }
+  this->poseDirty = true;
+  this->fadeDirty = true;
+  this->globalsDirty = true;
 }
 
+Skeleton *Controller::getSkeleton() const { return this->skeleton; }
+
 Clip *Controller::getClip(size_t index) const
 {
   if (index < this->clips.size())
@@ -43,8 +68,29 @@ Clip *Controller::getClip(size_t index) const
   }
 }
 
+void Controller::resetPose(Pose &pose, Clip *clip)
+{
+  Pose &base = clip->getBasePose();
+  if (base.size() == pose.size())
+  {
+    pose = base;
+  }
+  else
+  {
+    pose = this->skeleton->restPose;
+  }
+}
+
+void Controller::setPoseCache(PoseCache *cache)
+{
+  this->poseCache = cache;
+  this->cacheEntry = nullptr;
+}
+PoseCache *Controller::getPoseCache() const { return this->poseCache; }
+
 void Controller::update(float deltaTime)
 {
+  this->cacheEntry = nullptr;
 
   if (this->state == PLAYING)
   {
@@ -54,21 +100,244 @@ void Controller::update(float deltaTime)
       return;
     }
 
-    *this->outPose = this->skeleton->restPose;
     Clip *clip = this->getClip(this->currentClip);
 
     if (clip == nullptr)
     {
-      std::cout << "Clip " << clip->GetName() << " not found in controller\n";
+      std::cout << "Clip " << this->currentClip << " not found in controller\n";
       return;
     }
 
-    clip->sample(*outPose, this->elapsed);
+    // a clip writes the same channels every frame, so the channels it leaves
+    // alone only need to be reset when the clip changes
+    if (this->poseDirty)
+    {
+      this->resetPose(*this->outPose, clip);
+      this->poseDirty = false;
+    }
+
+    // plain playback of a clip can be shared with other controllers
+    bool shared = this->poseCache != nullptr && !this->fading && this->layers.empty();
+    float time = this->elapsed;
+    if (shared)
+    {
+      time = clip->adjustTimeToFitRange(this->elapsed);
+      PoseCache::Entry *entry = this->poseCache->find(this->skeleton, clip, time);
+      if (entry != nullptr)
+      {
+        *this->outPose = entry->pose;
+        this->finalPose = this->outPose;
+        if (entry->globals.empty())
+        {
+          this->cacheEntry = entry;
+          this->cacheFrame = this->poseCache->getFrame();
+          this->globalsDirty = true;
+        }
+        else
+        {
+          this->globals = entry->globals;
+          this->globalsDirty = false;
+        }
+
+        this->elapsed += deltaTime * this->speed;
+        return;
+      }
+    }
+
+    clip->sample(*outPose, shared ? this->poseCache->quantize(time) : time);
+    this->finalPose = this->outPose;
+
+    if (shared)
+    {
+      this->cacheEntry = this->poseCache->insert(this->skeleton, clip, time, *this->outPose);
+      this->cacheFrame = this->poseCache->getFrame();
+    }
+
+    if (this->fading)
+    {
+      Clip *target = this->clips[this->fadeClip];
+      if (this->fadeDirty)
+      {
+        this->resetPose(*this->fadePose, target);
+        this->fadeDirty = false;
+      }
+      target->sample(*this->fadePose, this->fadeTime);
+
+      float t = 1.0f;
+      if (this->fadeDuration > 0.0f)
+      {
+        t = std::min(this->fadeElapsed / this->fadeDuration, 1.0f);
+      }
+
+      this->fadeTime += deltaTime * this->speed;
+      this->fadeElapsed += deltaTime;
+
+      if (t >= 1.0f)
+      {
+        this->finishFade();
+      }
+      else
+      {
+        // one pass writes the blend of both samples, no pose copy
+        this->blendPose->blend(*this->outPose, *this->fadePose, t, std::vector<float>());
+        this->finalPose = this->blendPose;
+      }
+    }
+
+    this->updateLayers(deltaTime);
+    this->globalsDirty = true;
 
     this->elapsed += deltaTime * this->speed;
   }
 }
 
+void Controller::finishFade()
+{
+  if (this->fadeDirty)
+  {
+    Clip *target = this->clips[this->fadeClip];
+    this->resetPose(*this->fadePose, target);
+    target->sample(*this->fadePose, this->fadeTime);
+  }
+
+  // the target's samples already hold its static channels
+  std::swap(this->outPose, this->fadePose);
+  this->currentClip = this->fadeClip;
+  this->elapsed = this->fadeTime;
+  this->fading = false;
+  this->fadeDirty = true;
+  this->poseDirty = false;
+  this->finalPose = this->outPose;
+}
+
+void Controller::updateLayers(float deltaTime)
+{
+  if (this->layers.empty())
+  {
+    return;
+  }
+
+  if (this->finalPose != this->blendPose)
+  {
+    *this->blendPose = *this->finalPose;
+    this->finalPose = this->blendPose;
+  }
+
+  for (auto &layer : this->layers)
+  {
+    Clip *clip = this->clips[layer.clip];
+    if (layer.weight > 0.0f)
+    {
+      clip->sample(*layer.pose, layer.time);
+      if (layer.additive)
+      {
+        this->blendPose->addDelta(*layer.pose, *layer.reference, layer.weight, layer.mask);
+      }
+      else
+      {
+        this->blendPose->blend(*this->blendPose, *layer.pose, layer.weight, layer.mask);
+      }
+    }
+    layer.time += deltaTime * this->speed;
+  }
+}
+
+void Controller::crossfade(size_t index, float duration)
+{
+  if (index >= this->clips.size())
+  {
+    std::cout << "Clip with index (" << index << ") does not exist" << "\n";
+    return;
+  }
+
+  if (this->fading)
+  {
+    this->finishFade();
+  }
+
+  if (index == this->currentClip)
+  {
+    return;
+  }
+
+  this->fading = true;
+  this->fadeDirty = true;
+  this->fadeClip = index;
+  this->fadeTime = 0.0f;
+  this->fadeElapsed = 0.0f;
+  this->fadeDuration = duration;
+}
+
+bool Controller::isFading() const { return this->fading; }
+
+size_t Controller::addLayer(size_t clip, float weight, bool additive,
+                            const std::vector<float> &mask)
+{
+  if (clip >= this->clips.size() || this->skeleton == nullptr)
+  {
+    std::cout << "Clip with index (" << clip << ") can not be layered" << "\n";
+    return this->layers.size();
+  }
+
+  AnimationLayer layer;
+  layer.clip = clip;
+  layer.weight = weight;
+  layer.time = 0.0f;
+  layer.additive = additive;
+  layer.mask = mask;
+  layer.pose = new Pose(this->skeleton->restPose);
+  this->resetPose(*layer.pose, this->clips[clip]);
+  layer.reference = new Pose(*layer.pose);
+  this->clips[clip]->sample(*layer.reference, this->clips[clip]->GetStartTime());
+
+  this->layers.push_back(layer);
+  return this->layers.size() - 1;
+}
+
+void Controller::setLayerWeight(size_t layer, float weight)
+{
+  if (layer < this->layers.size())
+  {
+    this->layers[layer].weight = weight;
+  }
+}
+
+void Controller::removeLayer(size_t layer)
+{
+  if (layer < this->layers.size())
+  {
+    delete this->layers[layer].pose;
+    delete this->layers[layer].reference;
+    this->layers.erase(this->layers.begin() + layer);
+  }
+}
+
+size_t Controller::layerCount() const { return this->layers.size(); }
+
+std::vector<float> Controller::getJointMask(size_t root)
+{
+  std::vector<float> mask;
+  if (this->skeleton == nullptr)
+  {
+    return mask;
+  }
+
+  Pose &rest = this->skeleton->restPose;
+  mask.resize(rest.size(), 0.0f);
+  for (size_t i = 0; i < mask.size(); ++i)
+  {
+    for (int joint = (int)i; joint != -1; joint = rest.getParent(joint))
+    {
+      if (joint == (int)root)
+      {
+        mask[i] = 1.0f;
+        break;
+      }
+    }
+  }
+  return mask;
+}
+
 void Controller::pause()
 {
   if (this->state == PLAYING)
@@ -103,6 +372,8 @@ void Controller::setCurrentAnimation(size_t index)
   if (index < this->clips.size())
   {
     this->currentClip = index;
+    this->poseDirty = true;
+    this->fading = false;
   }
   else
   {
@@ -116,25 +387,53 @@ void Controller::reset()
   this->elapsed = 0.0f;
 }
 
-std::vector<Mat4x4> Controller::getPose()
+void Controller::getPalette(size_t skin, std::vector<Mat4x4> &out)
 {
-  std::vector<Mat4x4> result;
+  out.clear();
 
-  if ((this->outPose != nullptr) && (this->skeleton != nullptr))
+  if ((this->finalPose == nullptr) || (this->skeleton == nullptr) ||
+      (skin >= this->skeleton->skins.size()))
   {
-    int len = this->outPose->size();
-    result.resize(len, identity());
-    for (int i = 0; i < len; ++i)
-    {
-      Transform world = this->outPose->getGlobalTransform(i);
-      Mat4x4 invPose = this->skeleton->inversePose[i];
+    return;
+  }
 
-      result[i] = world.get() * invPose;
-    }
+  this->updateGlobals();
+
+  const Skin &bound = this->skeleton->skins[skin];
+  out.resize(bound.joints.size());
+  for (size_t i = 0; i < bound.joints.size(); ++i)
+  {
+    out[i] = this->globals[bound.joints[i]] * bound.inverseBindMatrices[i];
   }
+}
+Mat4x4 Controller::getJointMatrix(size_t joint)
+{
+  if ((this->finalPose == nullptr) || (joint >= this->finalPose->size()))
+  {
+    return identity();
+  }
+
+  this->updateGlobals();
+  return this->globals[joint];
+}
+
+void Controller::updateGlobals()
+{
+  if (this->globalsDirty)
+  {
+    this->finalPose->getMatrixPalette(this->globals);
+    this->globalsDirty = false;
 
-  return result;
+    // a palette read in a later frame would find the entry freed
+    if (this->cacheEntry != nullptr && this->poseCache != nullptr &&
+        this->poseCache->getFrame() == this->cacheFrame)
+    {
+      this->cacheEntry->globals = this->globals;
+    }
+    this->cacheEntry = nullptr;
+  }
 }
+
 bool Controller::isPlaying() const
 {
   return this->state == PLAYING;
@@ -185,9 +484,19 @@ void Controller::clean()
   }
   this->clips.clear();
 
+  while (!this->layers.empty())
+  {
+    this->removeLayer(this->layers.size() - 1);
+  }
+
   if (this->outPose != nullptr)
   {
     delete this->outPose;
+    delete this->fadePose;
+    delete this->blendPose;
     this->outPose = nullptr;
+    this->fadePose = nullptr;
+    this->blendPose = nullptr;
+    this->finalPose = nullptr;
   }
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include "../../math/mat4.h"
+#include "poseCache.h"
 // animation controller class
 // This class is responsible for managing the animation state and transitions
 
@@ -16,6 +17,21 @@ enum AnimationState
   RESUMED
 };
 
+/// @brief clip played on top of the controller's clip
+struct AnimationLayer
+{
+  size_t clip;
+  float weight;
+  float time;
+  // adds the clip's change from its first frame instead of blending to it
+  bool additive;
+  // per joint weight, empty to affect every joint
+  std::vector<float> mask;
+  class Pose *pose;
+  // first frame of the clip, the zero point of additive layers
+  class Pose *reference;
+};
+
 class Controller
 {
 
@@ -31,7 +47,46 @@ private:
 
   AnimationState state;
 
+  // samples of the current clip
   class Pose *outPose;
+  // samples of the clip being faded to
+  class Pose *fadePose;
+  // result of fades and layers
+  class Pose *blendPose;
+  // pose the palette is built from, outPose unless something is blended
+  class Pose *finalPose;
+
+  // set when outPose no longer holds the static channels of the current clip
+  bool poseDirty;
+
+  // model space joint matrices of outPose, shared by every skin
+  std::vector<Mat4x4> globals;
+  bool globalsDirty;
+
+  // crossfade from the current clip to fadeClip
+  bool fading;
+  bool fadeDirty;
+  size_t fadeClip;
+  // time in fadeClip
+  float fadeTime;
+  float fadeElapsed;
+  float fadeDuration;
+
+  std::vector<AnimationLayer> layers;
+
+  // shares samples with controllers playing the same clip, not owned
+  PoseCache *poseCache;
+  // cache entry sampled by this controller this frame, gets the joint
+  // matrices once they are built. only valid while the cache is still on
+  // cacheFrame, beginFrame frees every entry
+  PoseCache::Entry *cacheEntry;
+  uint64_t cacheFrame;
+
+  void updateGlobals();
+  /// @brief sets the channels clip does not animate
+  void resetPose(class Pose &pose, class Clip *clip);
+  void updateLayers(float deltaTime);
+  void finishFade();
 
   std::vector<class Clip *> clips;
 
@@ -42,11 +97,46 @@ public:
         currentClip(0),
         skeleton(nullptr),
         state(STOPPED),
-        outPose(nullptr) {}
+        outPose(nullptr),
+        fadePose(nullptr),
+        blendPose(nullptr),
+        finalPose(nullptr),
+        poseDirty(true),
+        globalsDirty(true),
+        fading(false),
+        fadeDirty(true),
+        fadeClip(0),
+        fadeTime(0.0f),
+        fadeElapsed(0.0f),
+        fadeDuration(0.0f),
+        poseCache(nullptr),
+        cacheEntry(nullptr),
+        cacheFrame(0) {}
 
   // function definations
   void setCurrentAnimation(size_t index);
+  /// @brief blends from the current clip to another over duration seconds,
+  /// the new clip starts from its beginning. a fade in progress is finished
+  /// first
+  void crossfade(size_t index, float duration);
+  bool isFading() const;
+
+  /// @brief plays a clip on top of the current one, either blended over it
+  /// by weight or added as the difference to its first frame
+  /// @return layer index
+  size_t addLayer(size_t clip, float weight, bool additive,
+                  const std::vector<float> &mask = std::vector<float>());
+  void setLayerWeight(size_t layer, float weight);
+  void removeLayer(size_t layer);
+  size_t layerCount() const;
+  /// @brief mask selecting a joint and every joint below it
+  std::vector<float> getJointMask(size_t root);
   void setSkeleton(class Skeleton *skeleton);
+  class Skeleton *getSkeleton() const;
+  /// @brief shares sampled poses through cache while the controller plays a
+  /// single clip without fades or layers, nullptr to sample alone
+  void setPoseCache(PoseCache *cache);
+  PoseCache *getPoseCache() const;
   void addClip(class Clip *clip);
   void removeClip(size_t index);
   size_t clipCount() const;
@@ -63,7 +153,12 @@ public:
   float getSpeed() const;
   void setSpeed(float inSpeed);
 
-  std::vector<Mat4x4> getPose();
+  /// @brief skinning matrices of one skin of the skeleton, one per entry of
+  /// the skin's joint list
+  void getPalette(size_t skin, std::vector<Mat4x4> &out);
+  /// @brief model space matrix of a joint in the current pose, used to draw
+  /// rigid meshes attached to it
+  Mat4x4 getJointMatrix(size_t joint);
 
   void reset();
 
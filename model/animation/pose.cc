@@ -1,8 +1,45 @@
 #include "pose.h"
 #include "../../math/mat4.h"
 #include "../../math/transform.h"
+#include <algorithm>
 #include <cstring>
 
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define POSE_SSE
+#endif
+
+namespace
+{
+#ifdef POSE_SSE
+  inline __m128 lerp4(__m128 a, __m128 b, __m128 t)
+  {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+  }
+
+  inline __m128 dot4(__m128 a, __m128 b)
+  {
+    __m128 m = _mm_mul_ps(a, b);
+    __m128 s = _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+  }
+
+  // blends into a, flipping b into a's hemisphere and normalizing the result
+  inline __m128 nlerp4(__m128 a, __m128 b, __m128 t)
+  {
+    __m128 sign = _mm_and_ps(dot4(a, b), _mm_set1_ps(-0.0f));
+    __m128 q = lerp4(a, _mm_xor_ps(b, sign), t);
+    __m128 lengthSqrd = dot4(q, q);
+    __m128 estimate = _mm_rsqrt_ps(lengthSqrd);
+    // one newton-raphson step
+    __m128 refined = _mm_mul_ps(
+        _mm_mul_ps(_mm_set1_ps(0.5f), estimate),
+        _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(lengthSqrd, estimate), estimate)));
+    return _mm_mul_ps(q, refined);
+  }
+#endif
+} // namespace
+
 Pose::Pose(size_t nJoints) { this->resize(nJoints); }
 
 Pose::Pose(const Pose &p) { *this = p; }
@@ -124,3 +161,92 @@ bool Pose::operator==(const Pose &other)
   return true;
 }
 bool Pose::operator!=(const Pose &other) { return !(*this == other); }
+
+void Pose::blend(Pose &from, Pose &to, float t, const std::vector<float> &mask)
+{
+  if (this != &from)
+  {
+    this->parents = from.parents;
+    this->joints.resize(from.joints.size());
+  }
+
+  size_t size = std::min(from.joints.size(), to.joints.size());
+  bool masked = mask.size() >= size;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    float weight = masked ? t * mask[i] : t;
+    const Transform &a = from.joints[i];
+    if (weight <= 0.0f)
+    {
+      this->joints[i] = a;
+      continue;
+    }
+
+    Transform &out = this->joints[i];
+    const Transform &b = to.joints[i];
+#ifdef POSE_SSE
+    __m128 w = _mm_set1_ps(weight);
+    _mm_storeu_ps(out.translation.v, lerp4(_mm_loadu_ps(a.translation.v),
+                                           _mm_loadu_ps(b.translation.v), w));
+    _mm_storeu_ps(out.orientation.v, nlerp4(_mm_loadu_ps(a.orientation.v),
+                                            _mm_loadu_ps(b.orientation.v), w));
+    _mm_storeu_ps(out.scaling.v, lerp4(_mm_loadu_ps(a.scaling.v),
+                                       _mm_loadu_ps(b.scaling.v), w));
+#else
+    Quat orientation = b.orientation;
+    if (dot(a.orientation, orientation) < 0.0f)
+    {
+      orientation = -1.0f * orientation;
+    }
+    out.translation = lerp(a.translation, b.translation, weight);
+    out.orientation = nlerp(a.orientation, orientation, weight);
+    out.scaling = lerp(a.scaling, b.scaling, weight);
+#endif
+  }
+}
+
+void Pose::addDelta(Pose &additive, Pose &reference, float weight,
+                    const std::vector<float> &mask)
+{
+  size_t size = std::min(this->joints.size(),
+                         std::min(additive.joints.size(), reference.joints.size()));
+  bool masked = mask.size() >= size;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    float w = masked ? weight * mask[i] : weight;
+    if (w <= 0.0f)
+    {
+      continue;
+    }
+
+    Transform &out = this->joints[i];
+    const Transform &add = additive.joints[i];
+    const Transform &ref = reference.joints[i];
+
+    // local rotation taking the reference to the layer (ref * delta = add),
+    // scaled from identity towards it
+    Quat delta = ref.orientation.inverse() * add.orientation;
+    if (delta.s < 0.0f)
+    {
+      delta = -1.0f * delta;
+    }
+    delta = nlerp(Quat(), delta, w);
+#ifdef POSE_SSE
+    __m128 wv = _mm_set1_ps(w);
+    __m128 translation = _mm_sub_ps(_mm_loadu_ps(add.translation.v),
+                                    _mm_loadu_ps(ref.translation.v));
+    _mm_storeu_ps(out.translation.v, _mm_add_ps(_mm_loadu_ps(out.translation.v),
+                                                 _mm_mul_ps(translation, wv)));
+    __m128 scaling = _mm_sub_ps(_mm_loadu_ps(add.scaling.v),
+                                _mm_loadu_ps(ref.scaling.v));
+    _mm_storeu_ps(out.scaling.v, _mm_add_ps(_mm_loadu_ps(out.scaling.v),
+                                            _mm_mul_ps(scaling, wv)));
+#else
+    out.translation = out.translation + (add.translation - ref.translation) * w;
+    out.scaling = out.scaling + (add.scaling - ref.scaling) * w;
+#endif
+    out.orientation = (out.orientation * delta).fastUnit();
+  }
+}
@@ -28,6 +28,17 @@ public:
 
   void getMatrixPalette(std::vector<struct Mat4x4> &out);
 
+  /// @brief writes the blend of from and to by t into this pose, which may be
+  /// from itself. translation, rotation and scaling are each one 16 byte lane
+  /// of a Transform and are blended with SSE where available
+  /// @param mask per joint weight multiplied with t, empty for every joint
+  void blend(Pose &from, Pose &to, float t, const std::vector<float> &mask);
+  /// @brief adds the difference between additive and reference to every
+  /// joint, scaled by weight
+  /// @param mask per joint weight multiplied with weight, empty for every joint
+  void addDelta(Pose &additive, Pose &reference, float weight,
+                const std::vector<float> &mask);
+
 private:
   std::vector<Transform> joints;
   std::vector<int> parents;
@@ -0,0 +1,80 @@
+#include "poseCache.h"
+#include <cmath>
+#include <cstring>
+
+void PoseCache::beginFrame()
+{
+  this->entries.clear();
+  this->frame++;
+}
+
+uint64_t PoseCache::getFrame() const { return this->frame; }
+
+void PoseCache::setQuantum(float seconds)
+{
+  this->quantum = seconds > 0.0f ? seconds : 0.0f;
+}
+
+float PoseCache::getQuantum() { return this->quantum; }
+
+float PoseCache::quantize(float time)
+{
+  if (this->quantum <= 0.0f)
+  {
+    return time;
+  }
+  return floorf(time / this->quantum) * this->quantum;
+}
+
+PoseCache::Key PoseCache::makeKey(const Skeleton *skeleton, const Clip *clip, float time)
+{
+  int64_t tick;
+  if (this->quantum > 0.0f)
+  {
+    tick = (int64_t)floorf(time / this->quantum);
+  }
+  else
+  {
+    // exact time, compared bit for bit
+    uint32_t bits;
+    memcpy(&bits, &time, sizeof(bits));
+    tick = bits;
+  }
+  return Key(skeleton, clip, tick);
+}
+
+PoseCache::Entry *PoseCache::find(const Skeleton *skeleton, const Clip *clip, float time)
+{
+  auto found = this->entries.find(this->makeKey(skeleton, clip, time));
+  if (found == this->entries.end())
+  {
+    this->misses++;
+    return nullptr;
+  }
+  this->hits++;
+  return &found->second;
+}
+
+PoseCache::Entry *PoseCache::insert(const Skeleton *skeleton, const Clip *clip,
+                                    float time, Pose &pose)
+{
+  Entry &entry = this->entries[this->makeKey(skeleton, clip, time)];
+  entry.pose = pose;
+  entry.globals.clear();
+  return &entry;
+}
+
+size_t PoseCache::getHits() { return this->hits; }
+size_t PoseCache::getMisses() { return this->misses; }
+
+float PoseCache::getHitRate()
+{
+  size_t lookups = this->hits + this->misses;
+  return lookups > 0 ? (float)this->hits / (float)lookups : 0.0f;
+}
+
+void PoseCache::resetStats()
+{
+  this->hits = 0;
+  this->misses = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef POSECACHE_H
+#define POSECACHE_H
+
+#include "../../math/mat4.h"
+#include "pose.h"
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+/// @brief poses sampled during the current frame, keyed by skeleton, clip
+/// and quantized time. controllers playing the same clip in lockstep share
+/// one sample and one set of joint matrices instead of each building their
+/// own. entries only live until the next frame starts.
+class PoseCache
+{
+public:
+  PoseCache() : quantum(0.0f), hits(0), misses(0), frame(0) {}
+  ~PoseCache() {}
+
+  struct Entry
+  {
+    Pose pose;
+    // model space joint matrices, empty until a controller builds them
+    std::vector<Mat4x4> globals;
+  };
+
+  /// @brief drops the previous frame's poses
+  void beginFrame();
+  /// @brief counts beginFrame calls, entries are only valid during the
+  /// frame they were found or inserted in
+  uint64_t getFrame() const;
+
+  /// @brief sample times are snapped to multiples of quantum so controllers
+  /// that are slightly out of step still share poses, 0 keeps exact times
+  void setQuantum(float seconds);
+  float getQuantum();
+  float quantize(float time);
+
+  /// @brief pose sampled this frame, nullptr if there is none yet
+  Entry *find(const class Skeleton *skeleton, const class Clip *clip, float time);
+  Entry *insert(const class Skeleton *skeleton, const class Clip *clip,
+                float time, Pose &pose);
+
+  size_t getHits();
+  size_t getMisses();
+  float getHitRate();
+  void resetStats();
+
+private:
+  typedef std::tuple<const class Skeleton *, const class Clip *, int64_t> Key;
+
+  float quantum;
+  size_t hits;
+  size_t misses;
+  uint64_t frame;
+  std::map<Key, Entry> entries;
+
+  Key makeKey(const class Skeleton *skeleton, const class Clip *clip, float time);
+};
+
+#endif
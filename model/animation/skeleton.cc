@@ -1,4 +1,13 @@
 #include "skeleton.h"
 #include "pose.h"
 
-Skeleton::Skeleton() : restPose(Pose()) {}
\ No newline at end of file
+Skeleton::Skeleton() : restPose(Pose()) {}
+
+int Skeleton::getJoint(int node) const
+{
+  if (node < 0 || node >= (int)this->nodeJoints.size())
+  {
+    return -1;
+  }
+  return this->nodeJoints[node];
+}
@@ -6,6 +6,15 @@
 #include <vector>
 #include <string>
 
+/// @brief joints a mesh is bound to. vertex joint indices index into joints,
+/// so the palette of a skin only holds the joints it actually uses
+struct Skin
+{
+  // skeleton joint of every palette entry
+  std::vector<unsigned int> joints;
+  std::vector<Mat4x4> inverseBindMatrices;
+};
+
 class Skeleton
 {
 public:
@@ -13,10 +22,15 @@ public:
   ~Skeleton() {}
 
   Pose restPose;
-  std::vector<Mat4x4> inversePose;
   std::vector<std::string> jointNames;
+  std::vector<Skin> skins;
+  // joint built from every source node, -1 for nodes outside the skeleton
+  std::vector<int> nodeJoints;
+
+  /// @brief skeleton joint of a source node, -1 if it is not part of it
+  int getJoint(int node) const;
 
   // std::vector<Mat4x4> getFinalMat() const;
 };
 
-#endif
\ No newline at end of file
+#endif
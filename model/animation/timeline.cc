@@ -0,0 +1,50 @@
+#include "timeline.h"
+#include <algorithm>
+#include <cmath>
+
+unsigned int Timeline::size() { return (unsigned int)this->times.size(); }
+float Timeline::getStartTime() { return this->times[0]; }
+float Timeline::getEndTime() { return this->times[this->times.size() - 1]; }
+
+KeyLookup Timeline::lookup(float time, bool looping)
+{
+  KeyLookup result;
+
+  size_t count = this->times.size();
+  if (count < 2)
+  {
+    return result;
+  }
+
+  float startTime = this->times[0];
+  float endTime = this->times[count - 1];
+  float duration = endTime - startTime;
+
+  if (looping && duration > 0.0f)
+  {
+    time = fmodf(time - startTime, duration);
+    if (time < 0.0f)
+    {
+      time += duration;
+    }
+    time += startTime;
+  }
+  else
+  {
+    time = std::min(std::max(time, startTime), endTime);
+  }
+
+  auto after = std::upper_bound(this->times.begin(), this->times.end(), time);
+  size_t frame = after == this->times.begin() ? 0 : (size_t)(after - this->times.begin()) - 1;
+
+  result.frame = (unsigned int)frame;
+  result.next = (unsigned int)std::min(frame + 1, count - 1);
+
+  float frameDelta = this->times[result.next] - this->times[frame];
+  if (frameDelta > 0.0f)
+  {
+    result.t = (time - this->times[frame]) / frameDelta;
+  }
+
+  return result;
+}
@@ -0,0 +1,37 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <vector>
+
+/// @brief keys surrounding a sample time and the blend weight between them
+struct KeyLookup
+{
+  // key at or before the sample time
+  unsigned int frame{0};
+  // key after the sample time, equal to frame past the last key
+  unsigned int next{0};
+  float t{0.0f};
+};
+
+/// @brief key times shared by every track keyed on them. glTF samplers
+/// usually share one input accessor, so a clip typically needs a handful of
+/// timelines and one key search per timeline serves all of its tracks.
+class Timeline
+{
+public:
+  Timeline() {}
+  ~Timeline() {}
+
+  std::vector<float> times;
+
+  unsigned int size();
+  float getStartTime();
+  float getEndTime();
+
+  /// @brief finds the keys surrounding time
+  /// @param time sample time, wrapped into the timeline when looping and
+  /// clamped to it otherwise
+  KeyLookup lookup(float time, bool looping);
+};
+
+#endif
@@ -5,43 +5,6 @@ template class Track<float, 1>;
 template class Track<Vector3f, 3>;
 template class Track<Quat, 4>;
 
-namespace TrackHelpers
-{
-  inline float interpolate(float a, float b, float c)
-  {
-    return (1.0 - c) * a + c * b;
-  }
-  inline Vector3f interpolate(const Vector3f &a, const Vector3f &b, float c)
-  {
-    return lerp(a, b, c);
-  }
-  inline Quat interpolate(Quat &a, Quat &b, float c)
-  {
-    Quat result = mix(a, b, c);
-
-    if (dot(a, b) < 0.0)
-    {
-      result = mix(a, -1.0 * b, c);
-    }
-
-    return result.unit();
-  }
-
-  inline float AdjustHermiteResult(float f) { return f; }
-  inline Vector3f AdjustHermiteResult(const Vector3f &v) { return v; }
-  inline Quat AdjustHermiteResult(Quat &q) { return q.unit(); }
-
-  inline void Neighborhood(const float &a, float &b) {}
-  inline void Neighborhood(const Vector3f &a, Vector3f &b) {}
-  inline void Neighborhood(const Quat &a, Quat &b)
-  {
-    if (dot(a, b) < 0)
-    {
-      b = -1.0 * b;
-    }
-  }
-}; // namespace TrackHelpers
-
 template <typename T, size_t N>
 unsigned int Track<T, N>::size()
 {
@@ -49,136 +12,202 @@ unsigned int Track<T, N>::size()
 }
 
 template <typename T, size_t N>
-float Track<T, N>::getStartTime()
+void Track<T, N>::clear()
 {
-  return frames[0].time;
+  this->frames.clear();
+  this->timeline.reset();
 }
 
 template <typename T, size_t N>
-float Track<T, N>::getEndTime()
+float Track<T, N>::getStartTime()
 {
-  return frames[frames.size() - 1].time;
+  return this->timeline->getStartTime();
 }
 
 template <typename T, size_t N>
-T Track<T, N>::sample(float time, bool looping)
+float Track<T, N>::getEndTime()
 {
-  if (interpolation == Interpolation::Constant)
-  {
-    return sampleConst(time, looping);
-  }
-  else if (interpolation == Interpolation::Linear)
-  {
-    return sampleLinear(time, looping);
-  }
-  else
-  {
-    return sampleCubic(time, looping);
-  }
+  return this->timeline->getEndTime();
 }
 
 template <typename T, size_t N>
-T Track<T, N>::hermite(float t, const T &p1, const T &s1, const T &_p2,
-                       const T &s2)
+float Track<T, N>::getTime(size_t index)
 {
-  float tt = t * t;
-
-  float ttt = tt * t;
-  T p2 = _p2;
-  TrackHelpers::Neighborhood(p1, p2);
-  float h1 = 2.0f * ttt - 3.0f * tt + 1.0f;
-  float h2 = -2.0f * ttt + 3.0f * tt;
-  float h3 = ttt - 2.0f * tt + t;
-  float h4 = ttt - tt;
-  T result = p1 * h1 + p2 * h2 + s1 * h3 + s2 * h4;
-  return TrackHelpers::AdjustHermiteResult(result);
+  return this->timeline->times[index];
 }
 
 template <typename T, size_t N>
-size_t Track<T, N>::frameIndex(float time, bool looping)
+bool Track<T, N>::isConstant(float epsilon)
 {
-  if (this->frames.size() < 1)
+  size_t size = this->frames.size();
+  if (size < 1)
   {
-    return -1;
+    return false;
   }
 
-  if (looping)
+  const Frame<N> &first = this->frames[0];
+  for (size_t i = 0; i < size; ++i)
   {
-    float startTime = this->getStartTime();
-    float endTime = this->getEndTime();
-    float difference = endTime - startTime;
-    time = fmodf((time - startTime), difference);
-    if (time < 0.0)
+    const Frame<N> &frame = this->frames[i];
+    for (size_t j = 0; j < N; ++j)
     {
-      time += difference;
+      if (fabsf(frame.m_value[j] - first.m_value[j]) > epsilon)
+      {
+        return false;
+      }
+      if (this->interpolation == Interpolation::Cubic &&
+          (fabsf(frame.m_in[j]) > epsilon || fabsf(frame.m_out[j]) > epsilon))
+      {
+        return false;
+      }
     }
-    time += startTime;
   }
-  else
+
+  return true;
+}
+
+template <typename T, size_t N>
+bool Track<T, N>::canSpan(size_t first, size_t last, float tolerance)
+{
+  if (this->interpolation == Interpolation::Cubic)
   {
-    if (time <= this->getStartTime())
-    {
-      return 0;
-    }
-    if (time >= this->frames[this->frames.size() - 2].time)
-    {
-      return this->frames.size() - 2;
-    }
+    return last <= first + 1;
   }
 
-  for (size_t i = this->frames.size() - 1; i >= 0; --i)
+  T start = this->getValue(first);
+  T end = this->getValue(last);
+  float startTime = this->getTime(first);
+  float frameDelta = this->getTime(last) - startTime;
+
+  for (size_t i = first + 1; i < last; ++i)
   {
-    if (time >= this->frames[i].time)
+    T expected = this->getValue(i);
+    T reconstructed = start;
+    if (this->interpolation == Interpolation::Linear && frameDelta > 0.0f)
+    {
+      float t = (this->getTime(i) - startTime) / frameDelta;
+      reconstructed = TrackHelpers::interpolate(start, end, t);
+    }
+
+    if (TrackHelpers::distance(reconstructed, expected) > tolerance)
     {
-      return i;
+      return false;
     }
   }
 
-  return -1;
+  return true;
 }
 
 template <typename T, size_t N>
-float Track<T, N>::adjustToFitTrack(float time, bool looping)
+void Track<T, N>::keepFrames(const std::vector<size_t> &keep, std::shared_ptr<Timeline> times)
 {
-
-  size_t size = this->frames.size();
-
-  if (size < 1)
+  std::vector<Frame<N>> kept;
+  kept.reserve(keep.size());
+  for (size_t index : keep)
   {
-    return 0.0;
+    kept.push_back(this->frames[index]);
   }
+  this->frames = kept;
+  this->timeline = times;
 
-  float startTime = this->getStartTime();
-  float endTime = this->getEndTime();
-  float difference = endTime - startTime;
+  // keys that were neighbours before may no longer share a hemisphere
+  if (this->preconditioned)
+  {
+    this->preconditioned = false;
+    this->precondition();
+  }
+}
 
-  if (difference <= 0.0)
+template <typename T, size_t N>
+void Track<T, N>::precondition()
+{
+  if (this->preconditioned)
   {
-    return 0.0;
+    return;
   }
 
-  if (looping)
+  size_t count = this->frames.size();
+  if (N == 4)
   {
-    time = fmodf(time - startTime, difference);
-    if (time < 0.0)
+    for (size_t i = 0; i < count; ++i)
     {
-      time += difference;
+      Frame<N> &frame = this->frames[i];
+
+      float lengthSqrd = 0.0f;
+      float alignment = 0.0f;
+      for (size_t j = 0; j < N; ++j)
+      {
+        lengthSqrd += frame.m_value[j] * frame.m_value[j];
+        if (i > 0)
+        {
+          alignment += frame.m_value[j] * this->frames[i - 1].m_value[j];
+        }
+      }
+
+      float scale = lengthSqrd > 0.0f ? 1.0f / sqrtf(lengthSqrd) : 1.0f;
+      // -q is the same rotation, the curve through it has negated tangents
+      float sign = alignment < 0.0f ? -1.0f : 1.0f;
+      for (size_t j = 0; j < N; ++j)
+      {
+        frame.m_value[j] *= sign * scale;
+        frame.m_in[j] *= sign;
+        frame.m_out[j] *= sign;
+      }
     }
-    time += startTime;
   }
-  else
+
+  if (this->interpolation == Interpolation::Cubic)
   {
-    if (time <= startTime)
+    for (size_t i = 0; i < count; ++i)
     {
-      time = startTime;
-    }
-    if (time >= endTime)
-    {
-      return endTime;
+      // the first in and last out tangents are never used
+      float inDelta = i > 0 ? this->getTime(i) - this->getTime(i - 1) : 1.0f;
+      float outDelta = i + 1 < count ? this->getTime(i + 1) - this->getTime(i) : 1.0f;
+      for (size_t j = 0; j < N; ++j)
+      {
+        this->frames[i].m_in[j] *= inDelta;
+        this->frames[i].m_out[j] *= outDelta;
+      }
     }
   }
 
-  return time;
+  this->preconditioned = true;
+}
+
+template <typename T, size_t N>
+T Track<T, N>::getValue(size_t index)
+{
+  return this->cast(&this->frames[index].m_value[0]);
+}
+
+template <typename T, size_t N>
+T Track<T, N>::sample(float time, bool looping)
+{
+  return this->sample(this->timeline->lookup(time, looping));
+}
+
+template <typename T, size_t N>
+T Track<T, N>::sample(const KeyLookup &key)
+{
+  if (interpolation == Interpolation::Constant)
+  {
+    return sampleConst(key);
+  }
+  else if (interpolation == Interpolation::Linear)
+  {
+    return sampleLinear(key);
+  }
+  else
+  {
+    return sampleCubic(key);
+  }
+}
+
+template <typename T, size_t N>
+T Track<T, N>::hermite(float t, const T &p1, const T &s1, const T &p2,
+                       const T &s2)
+{
+  return TrackHelpers::hermite(t, p1, s1, p2, s2);
 }
 
 template <>
@@ -195,72 +224,67 @@ Quat Track<Quat, 4>::cast(float *value)
   return r.unit();
 }
 
-template <typename T, size_t N>
-T Track<T, N>::sampleConst(float time, bool looping)
+template <>
+float Track<float, 1>::load(const float *value) { return value[0]; }
+template <>
+Vector3f Track<Vector3f, 3>::load(const float *value)
 {
-  size_t index = this->frameIndex(time, looping);
-
-  if ((int)index < 0 || (int)index >= (int)this->frames.size())
-  {
-    return T();
-  }
-
-  return this->cast(&this->frames[index].m_value[0]);
+  return Vector3f(value[0], value[1], value[2]);
+}
+template <>
+Quat Track<Quat, 4>::load(const float *value)
+{
+  // preconditioned keys are already unit length
+  return Quat(value[0], value[1], value[2], value[3]);
 }
 
 template <typename T, size_t N>
-T Track<T, N>::sampleLinear(float time, bool looping)
+T Track<T, N>::sampleConst(const KeyLookup &key)
 {
-  size_t index = this->frameIndex(time, looping);
-  if ((int)index < 0 || (int)index >= (int)this->frames.size() - 1)
-  {
-    return T();
-  }
-
-  int nextFrame = index + 1;
-  float trackTime = this->adjustToFitTrack(time, looping);
-  float thisTime = this->frames[index].time;
-  float frameDelta = this->frames[nextFrame].time - thisTime;
+  return this->getValue(key.frame);
+}
 
-  if (frameDelta <= 0.0)
+template <typename T, size_t N>
+T Track<T, N>::sampleLinear(const KeyLookup &key)
+{
+  if (this->preconditioned)
   {
-    return T();
+    return TrackHelpers::interpolateAligned(this->load(this->frames[key.frame].m_value),
+                                            this->load(this->frames[key.next].m_value),
+                                            key.t);
   }
 
-  float t = (trackTime - thisTime) / frameDelta;
-  T start = cast(&this->frames[index].m_value[0]);
-  T end = cast(&this->frames[nextFrame].m_value[0]);
+  T start = this->getValue(key.frame);
+  T end = this->getValue(key.next);
 
-  return TrackHelpers::interpolate(start, end, t);
+  return TrackHelpers::interpolate(start, end, key.t);
 }
+
 template <typename T, size_t N>
-T Track<T, N>::sampleCubic(float time, bool looping)
+T Track<T, N>::sampleCubic(const KeyLookup &key)
 {
-  int thisFrame = this->frameIndex(time, looping);
-  if (thisFrame < 0 || thisFrame >= this->frames.size() - 1)
+  if (this->preconditioned)
   {
-    return T();
+    T result = TrackHelpers::hermiteAligned(
+        key.t,
+        this->load(this->frames[key.frame].m_value),
+        this->load(this->frames[key.frame].m_out),
+        this->load(this->frames[key.next].m_value),
+        this->load(this->frames[key.next].m_in));
+    return TrackHelpers::AdjustAlignedResult(result);
   }
 
-  int nextFrame = thisFrame + 1;
-  float trackTime = this->adjustToFitTrack(time, looping);
-  float thisTime = this->frames[thisFrame].time;
-  float frameDelta = this->frames[nextFrame].time - thisTime;
-  if (frameDelta <= 0.0f)
-  {
-    return T();
-  }
+  float frameDelta = this->getTime(key.next) - this->getTime(key.frame);
 
-  float t = (trackTime - thisTime) / frameDelta;
   size_t fltSize = sizeof(float);
-  T point1 = cast(&this->frames[thisFrame].m_value[0]);
+  T point1 = this->getValue(key.frame);
   T slope1; // = mFrames[thisFrame].mOut * frameDelta;
-  memcpy(&slope1, this->frames[thisFrame].m_out, N * fltSize);
+  memcpy(&slope1, this->frames[key.frame].m_out, N * fltSize);
   slope1 = slope1 * frameDelta;
-  T point2 = cast(&this->frames[nextFrame].m_value[0]);
+  T point2 = this->getValue(key.next);
   T slope2; // = mFrames[nextFrame].mIn[0] * frameDelta;
-  memcpy(&slope2, this->frames[nextFrame].m_in, N * fltSize);
+  memcpy(&slope2, this->frames[key.next].m_in, N * fltSize);
   slope2 = slope2 * frameDelta;
 
-  return hermite(t, point1, slope1, point2, slope2);
+  return hermite(key.t, point1, slope1, point2, slope2);
 }
@@ -4,33 +4,160 @@
 #include "../../math/quaternion.h"
 #include "../../math/vec3.h"
 #include "frame.h"
+#include "timeline.h"
+#include <memory>
 #include <vector>
 
+// interpolation shared by every track representation
+namespace TrackHelpers
+{
+  inline float interpolate(float a, float b, float c)
+  {
+    return (1.0 - c) * a + c * b;
+  }
+  inline Vector3f interpolate(const Vector3f &a, const Vector3f &b, float c)
+  {
+    return lerp(a, b, c);
+  }
+  inline Quat interpolate(Quat &a, Quat &b, float c)
+  {
+    Quat result = mix(a, b, c);
+
+    if (dot(a, b) < 0.0)
+    {
+      result = mix(a, -1.0 * b, c);
+    }
+
+    return result.unit();
+  }
+
+  // keys of preconditioned tracks already share a hemisphere
+  inline float interpolateAligned(float a, float b, float c)
+  {
+    return (1.0f - c) * a + c * b;
+  }
+  inline Vector3f interpolateAligned(const Vector3f &a, const Vector3f &b, float c)
+  {
+    return lerp(a, b, c);
+  }
+  inline Quat interpolateAligned(const Quat &a, const Quat &b, float c)
+  {
+    return nlerp(a, b, c);
+  }
+
+  inline float AdjustHermiteResult(float f) { return f; }
+  inline Vector3f AdjustHermiteResult(const Vector3f &v) { return v; }
+  inline Quat AdjustHermiteResult(Quat &q) { return q.unit(); }
+
+  inline float AdjustAlignedResult(float f) { return f; }
+  inline Vector3f AdjustAlignedResult(const Vector3f &v) { return v; }
+  inline Quat AdjustAlignedResult(const Quat &q) { return q.fastUnit(); }
+
+  inline void Neighborhood(const float &, float &) {}
+  inline void Neighborhood(const Vector3f &, Vector3f &) {}
+  inline void Neighborhood(const Quat &a, Quat &b)
+  {
+    if (dot(a, b) < 0)
+    {
+      b = -1.0 * b;
+    }
+  }
+
+  // distance between two track values, radians for quaternions
+  inline float distance(float a, float b) { return fabsf(a - b); }
+  inline float distance(const Vector3f &a, const Vector3f &b) { return (a - b).mag(); }
+  inline float distance(const Quat &a, const Quat &b)
+  {
+    // the chord between unit quaternions is 2 sin(angle / 4), unlike acos of
+    // the dot product it stays accurate for tiny angles
+    float sign = dot(a, b) < 0.0f ? -1.0f : 1.0f;
+    float x = a.x - sign * b.x;
+    float y = a.y - sign * b.y;
+    float z = a.z - sign * b.z;
+    float s = a.s - sign * b.s;
+    float halfChord = 0.5f * sqrtf(x * x + y * y + z * z + s * s);
+    return 4.0f * asinf(halfChord < 1.0f ? halfChord : 1.0f);
+  }
+
+  /// @brief hermite basis without the hemisphere check or normalization
+  template <typename T>
+  inline T hermiteAligned(float t, const T &p1, const T &s1, const T &p2, const T &s2)
+  {
+    float tt = t * t;
+
+    float ttt = tt * t;
+    float h1 = 2.0f * ttt - 3.0f * tt + 1.0f;
+    float h2 = -2.0f * ttt + 3.0f * tt;
+    float h3 = ttt - 2.0f * tt + t;
+    float h4 = ttt - tt;
+    return p1 * h1 + p2 * h2 + s1 * h3 + s2 * h4;
+  }
+
+  template <typename T>
+  inline T hermite(float t, const T &p1, const T &s1, const T &_p2, const T &s2)
+  {
+    T p2 = _p2;
+    Neighborhood(p1, p2);
+    T result = hermiteAligned(t, p1, s1, p2, s2);
+    return AdjustHermiteResult(result);
+  }
+}; // namespace TrackHelpers
+
 /// @brief holds the animation for a single skeleton joint
 /// @tparam N track type (1=scalar track, 3=vector track, 4=quaternion track)
 template <typename T, size_t N> class Track {
 public:
-  Track() : interpolation(Linear) {}
+  Track() : timelineIndex(0), interpolation(Linear), preconditioned(false) {}
   ~Track() {}
 
   std::vector<Frame<N>> frames;
+  // key times, one per frame, usually shared with other tracks of the clip
+  std::shared_ptr<Timeline> timeline;
+  // index of timeline in the owning clip's timelines
+  unsigned int timelineIndex;
   Interpolation interpolation;
+  // keys normalized and in the hemisphere of the previous key, cubic
+  // tangents multiplied by the length of the span they are used on
+  bool preconditioned;
 
   unsigned int size();
+  void clear();
 
   float getStartTime();
   float getEndTime();
+  float getTime(size_t index);
+
+  /// @brief checks if every key holds the same value (and no tangents for
+  /// cubic tracks), i.e. the track evaluates to its first key at any time
+  bool isConstant(float epsilon = 1e-6f);
+
+  /// @brief checks if interpolating keys first and last reconstructs every
+  /// key in between within tolerance, always false for cubic tracks
+  bool canSpan(size_t first, size_t last, float tolerance);
+  /// @brief keeps only the given keys, in order, on a timeline holding
+  /// their times. Clip::reduce picks keys every track of a timeline can
+  /// drop, so they keep sharing one
+  void keepFrames(const std::vector<size_t> &keep, std::shared_ptr<Timeline> times);
+
+  /// @brief prepares the keys for sampling without hemisphere checks or
+  /// tangent scaling. keys can no longer be edited afterwards
+  void precondition();
 
   T sample(float time, bool looping);
-  T sampleConst(float time, bool looping);
-  T sampleLinear(float time, bool looping);
-  T sampleCubic(float time, bool looping);
+  /// @brief samples with keys already looked up on the track's timeline
+  T sample(const KeyLookup &key);
+  T sampleConst(const KeyLookup &key);
+  T sampleLinear(const KeyLookup &key);
+  T sampleCubic(const KeyLookup &key);
 
-  size_t frameIndex(float time, bool looping);
-  float adjustToFitTrack(float time, bool looping);
   T hermite(float time, const T &p1, const T &s1, const T &p2, const T &s2);
 
   T cast(float *value);
+  T getValue(size_t index);
+
+private:
+  // reads a key or tangent as stored, without normalizing
+  T load(const float *value);
 };
 
 typedef Track<float, 1> SCalarTrack;
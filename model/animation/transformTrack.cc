@@ -88,3 +88,65 @@ Transform TransformTrack::sample(const Transform &ref, float time,
 
   return result;
 }
+
+Transform TransformTrack::sample(const Transform &ref,
+                                 const std::vector<KeyLookup> &lookups) {
+  Transform result = ref;
+
+  if (this->position.size() > 1) {
+    result.translation =
+        this->position.sample(lookups[this->position.timelineIndex]);
+  }
+  if (this->rotation.size() > 1) {
+    result.orientation =
+        this->rotation.sample(lookups[this->rotation.timelineIndex]);
+  }
+  if (this->scaling.size() > 1) {
+    result.scaling = this->scaling.sample(lookups[this->scaling.timelineIndex]);
+  }
+
+  return result;
+}
+
+int TransformTrack::foldConstants(Transform &ref) {
+  int folded = 0;
+
+  // single key channels are never sampled, they only take up space
+  if (this->position.size() == 1) {
+    this->position.clear();
+  }
+  if (this->rotation.size() == 1) {
+    this->rotation.clear();
+  }
+  if (this->scaling.size() == 1) {
+    this->scaling.clear();
+  }
+
+  if (this->position.size() > 1 && this->position.isConstant()) {
+    ref.translation = this->position.getValue(0);
+    this->position.clear();
+    folded++;
+  }
+  if (this->rotation.size() > 1 && this->rotation.isConstant()) {
+    ref.orientation = this->rotation.getValue(0);
+    this->rotation.clear();
+    folded++;
+  }
+  if (this->scaling.size() > 1 && this->scaling.isConstant()) {
+    ref.scaling = this->scaling.getValue(0);
+    this->scaling.clear();
+    folded++;
+  }
+
+  return folded;
+}
+
+void TransformTrack::precondition() {
+  this->position.precondition();
+  this->rotation.precondition();
+  this->scaling.precondition();
+}
+
+size_t TransformTrack::keyCount() {
+  return this->position.size() + this->rotation.size() + this->scaling.size();
+}
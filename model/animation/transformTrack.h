@@ -21,6 +21,19 @@ public:
   bool isValid();
 
   Transform sample(const Transform &ref, float time, bool looping);
+  /// @brief samples with keys looked up once per timeline of the clip
+  /// @param lookups lookup results indexed by each channel's timelineIndex
+  Transform sample(const Transform &ref, const std::vector<KeyLookup> &lookups);
+
+  /// @brief writes channels that never change into ref and drops them from
+  /// the track so sampling only evaluates animated channels
+  /// @return number of channels folded
+  int foldConstants(Transform &ref);
+
+  size_t keyCount();
+
+  /// @brief see Track::precondition
+  void precondition();
 
 private:
   VectorTrack position;
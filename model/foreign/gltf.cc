@@ -7,10 +7,13 @@
 #include "../animation/frame.h"
 #include "../animation/pose.h"
 #include "../animation/skeleton.h"
+#include "../animation/timeline.h"
 #include "../model.h"
 #include "../renderer/mesh.h"
+#include <map>
 
-GLTFFile::GLTFFile(std::string &path)
+GLTFFile::GLTFFile(std::string &path, const GLTFImportSettings &settings)
+    : settings(settings)
 {
   tinygltf::TinyGLTF loader;
   std::string err, warn;
@@ -43,14 +46,35 @@ GLTFFile::GLTFFile(std::string &path)
   }
 }
 
-void GLTFFile::populateModel(Model &model)
+void printClipReport(const std::string &name, const ClipMemoryReport &report)
 {
-  model.meshes = this->getMeshes();
+  float saved = 0.0f;
+  if (report.rawBytes > 0)
+  {
+    saved = 100.0f * (1.0f - (float)report.compressedBytes / (float)report.rawBytes);
+  }
 
-  model.textures = this->getTextures();
+  std::cout << "clip " << name << ": " << report.keys << " keys, "
+            << report.rawBytes / 1024.0f << " KiB -> "
+            << report.compressedBytes / 1024.0f << " KiB (" << saved
+            << "% saved), " << report.fallbackChannels
+            << " channels over budget, max error pos " << report.maxPositionError
+            << " rot " << report.maxRotationError
+            << " scale " << report.maxScaleError << "\n";
+}
 
+void GLTFFile::populateModel(Model &model)
+{
   Skeleton skeleton;
   skeleton = this->getSkeleton();
+
+  model.meshes = this->getMeshes(skeleton);
+
+  if (this->settings.upload)
+  {
+    model.textures = this->getTextures();
+  }
+
   if (skeleton.restPose.size() > 0)
   {
     model.animController = new Controller();
@@ -58,7 +82,7 @@ void GLTFFile::populateModel(Model &model)
   }
 
   std::vector<Clip> clips;
-  clips = this->getClips();
+  clips = this->getClips(skeleton);
 
   if (model.animController == nullptr && clips.size() > 0)
   {
@@ -69,6 +93,41 @@ void GLTFFile::populateModel(Model &model)
   {
     for (auto clip : clips)
     {
+      bool verbose = this->settings.verbose;
+      if (this->settings.reduceKeys)
+      {
+        KeyReductionReport report = clip.reduce(skeleton.restPose, this->settings.reductionTolerance);
+        if (verbose)
+        {
+          std::cout << "clip " << clip.GetName() << ": keys " << report.keysBefore
+                    << " -> " << report.keysAfter << ", max joint error " << report.maxErrorAfter
+                    << " (tolerance " << this->settings.reductionTolerance << ")\n";
+        }
+      }
+      ClipOptimizeReport optimized = clip.optimize(skeleton.restPose);
+      if (verbose)
+      {
+        std::cout << "clip " << clip.GetName() << ": " << optimized.animated << "/"
+                  << optimized.tracks << " tracks animated, " << optimized.folded
+                  << " constant channels folded\n";
+      }
+      if (this->settings.bakeClips)
+      {
+        size_t bytes = clip.bake(skeleton.restPose, this->settings.bakeRate);
+        if (verbose)
+        {
+          std::cout << "clip " << clip.GetName() << ": baked at "
+                    << this->settings.bakeRate << " samples/s, " << bytes << " bytes\n";
+        }
+      }
+      else if (this->settings.compressClips)
+      {
+        ClipMemoryReport report = clip.compress(this->settings.compression);
+        if (verbose)
+        {
+          printClipReport(clip.GetName(), report);
+        }
+      }
       model.animController->addClip(new Clip(clip));
     }
   }
@@ -79,10 +138,32 @@ void GLTFFile::populateModel(Model &model)
 template <typename T>
 const T *getData(const tinygltf::Model &tinyModel, const int index);
 
-std::vector<Mesh> GLTFFile::getMeshes()
+std::vector<Mesh> GLTFFile::getMeshes(const Skeleton &skeleton)
 {
   std::vector<Mesh> meshes;
 
+  // skin or node every mesh is attached to through the first node
+  // instancing it
+  std::vector<int> meshSkins(this->tinyModel.meshes.size(), -1);
+  std::vector<int> meshNodes(this->tinyModel.meshes.size(), -1);
+  for (size_t n = 0; n < this->tinyModel.nodes.size(); n++)
+  {
+    const tinygltf::Node &node = this->tinyModel.nodes[n];
+    if (node.mesh < 0 || meshSkins[node.mesh] != -1 || meshNodes[node.mesh] != -1)
+    {
+      continue;
+    }
+
+    if (node.skin >= 0)
+    {
+      meshSkins[node.mesh] = node.skin;
+    }
+    else
+    {
+      meshNodes[node.mesh] = skeleton.getJoint((int)n);
+    }
+  }
+
   for (size_t m = 0; m < this->tinyModel.meshes.size(); ++m)
   {
     tinygltf::Mesh &mesh = this->tinyModel.meshes[m];
@@ -91,6 +172,8 @@ std::vector<Mesh> GLTFFile::getMeshes()
     {
       Mesh tmpmesh = {};
       tmpmesh.mode = TRIANGLES;
+      tmpmesh.skin = meshSkins[m];
+      tmpmesh.node = meshNodes[m];
 
       tinygltf::Primitive &primitive = mesh.primitives[j];
       // positions
@@ -246,9 +329,6 @@ std::vector<Mesh> GLTFFile::getMeshes()
         const tinygltf::Accessor &accessor = tinyModel.accessors[it->second];
         int count = accessor.count;
 
-        std::vector<int> skinjoints;
-        skinjoints = tinyModel.skins[0].joints;
-
         for (size_t i = 0; i < count; ++i)
         {
           int joint_indices[4] = {0, 0, 0, 0};
@@ -274,10 +354,11 @@ std::vector<Mesh> GLTFFile::getMeshes()
             std::cerr << "Unsupported joint component type: " << accessor.componentType << std::endl;
           }
 
-          tmpmesh.vertices[i].joints[0] = skinjoints[joint_indices[0]];
-          tmpmesh.vertices[i].joints[1] = skinjoints[joint_indices[1]];
-          tmpmesh.vertices[i].joints[2] = skinjoints[joint_indices[2]];
-          tmpmesh.vertices[i].joints[3] = skinjoints[joint_indices[3]];
+          // indices into the skin's palette
+          tmpmesh.vertices[i].joints[0] = joint_indices[0];
+          tmpmesh.vertices[i].joints[1] = joint_indices[1];
+          tmpmesh.vertices[i].joints[2] = joint_indices[2];
+          tmpmesh.vertices[i].joints[3] = joint_indices[3];
         };
       }
       else
@@ -401,7 +482,14 @@ std::vector<Mesh> GLTFFile::getMeshes()
       Vector3f minBounds = Vector3f(std::numeric_limits<float>::max());
       Vector3f maxBounds = Vector3f(-std::numeric_limits<float>::max());
 
-      tmpmesh.init();
+      if (this->settings.upload)
+      {
+        tmpmesh.init();
+      }
+      else
+      {
+        tmpmesh.countInfluences();
+      }
       meshes.push_back(tmpmesh);
     }
   }
@@ -440,186 +528,262 @@ std::vector<Texture> GLTFFile::getTextures()
   return textures;
 }
 
-std::vector<std::string> getJointNames(const tinygltf::Model &tinyModel)
+Transform getNodeTransform(const tinygltf::Node &node)
 {
+  Transform finalTransform;
+
+  if (node.matrix.size() != 0)
+  {
+    const std::vector<double> &m = node.matrix;
+    finalTransform = transformFromMat(
+        Mat4x4(
+            m[0], m[1], m[2], m[3],
+            m[4], m[5], m[6], m[7],
+            m[8], m[9], m[10], m[11],
+            m[12], m[13], m[14], m[15])
+            .transpose());
+  }
+
+  if (node.translation.size() != 0)
+  {
+    finalTransform.translation = Vector3f(node.translation[0], node.translation[1], node.translation[2]);
+  }
 
-  std::vector<std::string> names;
-  names.resize(tinyModel.nodes.size());
-  for (size_t i = 0; i < tinyModel.nodes.size(); i++)
+  if (node.scale.size() != 0)
   {
-    const tinygltf::Node &node = tinyModel.nodes[i];
-    names[i] = node.name;
+    finalTransform.scaling = Vector3f(node.scale[0], node.scale[1], node.scale[2]);
   }
 
-  return names;
+  if (node.rotation.size() != 0)
+  {
+    finalTransform.orientation = Quat(
+        node.rotation[0],
+        node.rotation[1],
+        node.rotation[2],
+        node.rotation[3]);
+  }
+
+  return finalTransform;
 }
 
-Pose getRestPose(const tinygltf::Model &tinyModel)
+Skin getSkin(const tinygltf::Model &tinyModel, const tinygltf::Skin &skin,
+             const Skeleton &skeleton)
 {
-  Pose result;
-  result.resize(tinyModel.nodes.size());
+  Skin result;
+  result.joints.resize(skin.joints.size());
+  result.inverseBindMatrices.resize(skin.joints.size(), identity());
 
-  for (int i = 0; i < tinyModel.nodes.size(); i++)
+  for (size_t j = 0; j < skin.joints.size(); j++)
   {
+    result.joints[j] = (unsigned int)skeleton.getJoint(skin.joints[j]);
+  }
 
-    const tinygltf::Node &node = tinyModel.nodes[i];
+  if (skin.inverseBindMatrices < 0)
+  {
+    std::cout << "no inverse bind matrices found for skin " << skin.name << "!\n";
+    return result;
+  }
+  const float *data = getData<float>(tinyModel, skin.inverseBindMatrices);
 
-    Transform finalTransform;
+  for (size_t j = 0; j < skin.joints.size(); j++)
+  {
+    result.inverseBindMatrices[j] = Mat4x4(&data[j * 16]).transpose();
+  }
+  return result;
+}
 
-    if (node.matrix.size() != 0)
+/// @brief builds the skeleton from the joints of every skin, the nodes rigid
+/// meshes are attached to and the nodes above them. other nodes (cameras,
+/// helpers, skinned mesh nodes) are left out
+Skeleton GLTFFile::getSkeleton()
+{
+  Skeleton result;
+
+  size_t nodeCount = this->tinyModel.nodes.size();
+  std::vector<int> parents(nodeCount, -1);
+  for (size_t i = 0; i < nodeCount; i++)
+  {
+    for (int child : this->tinyModel.nodes[i].children)
     {
-      const std::vector<double> &m = node.matrix;
-      finalTransform = transformFromMat(
-          Mat4x4(
-              m[0], m[1], m[2], m[3],
-              m[4], m[5], m[6], m[7],
-              m[8], m[9], m[10], m[11],
-              m[12], m[13], m[14], m[15])
-              .transpose());
+      parents[child] = (int)i;
     }
+  }
 
-    if (node.translation.size() != 0)
+  std::vector<bool> used(nodeCount, false);
+  auto use = [&used, &parents](int joint)
+  {
+    for (int node = joint; node != -1 && !used[node]; node = parents[node])
     {
-      finalTransform.translation = Vector3f(node.translation[0], node.translation[1], node.translation[2]);
+      used[node] = true;
     }
+  };
 
-    if (node.scale.size() != 0)
+  for (const tinygltf::Skin &skin : this->tinyModel.skins)
+  {
+    for (int joint : skin.joints)
     {
-      finalTransform.scaling = Vector3f(node.scale[0], node.scale[1], node.scale[2]);
+      use(joint);
     }
-
-    if (node.rotation.size() != 0)
+  }
+  for (size_t i = 0; i < nodeCount; i++)
+  {
+    const tinygltf::Node &node = this->tinyModel.nodes[i];
+    if (node.mesh >= 0 && node.skin < 0)
     {
-      finalTransform.orientation = Quat(
-          node.rotation[0],
-          node.rotation[1],
-          node.rotation[2],
-          node.rotation[3]);
+      use((int)i);
     }
+  }
 
-    result.setLocalTransform(i, finalTransform);
-
-    for (size_t j = 0; j < node.children.size(); j++)
+  std::vector<int> jointNodes;
+  result.nodeJoints.resize(nodeCount, -1);
+  for (size_t i = 0; i < nodeCount; i++)
+  {
+    if (used[i])
     {
-      result.setParent(node.children[j], i);
+      result.nodeJoints[i] = (int)jointNodes.size();
+      jointNodes.push_back((int)i);
     }
   }
 
+  result.restPose.resize(jointNodes.size());
+  result.jointNames.resize(jointNodes.size());
+  for (size_t j = 0; j < jointNodes.size(); j++)
+  {
+    const tinygltf::Node &node = this->tinyModel.nodes[jointNodes[j]];
+    result.jointNames[j] = node.name;
+    result.restPose.setLocalTransform(j, getNodeTransform(node));
+    result.restPose.setParent(j, result.getJoint(parents[jointNodes[j]]));
+  }
+
+  for (const tinygltf::Skin &skin : this->tinyModel.skins)
+  {
+    result.skins.push_back(getSkin(this->tinyModel, skin, result));
+  }
+
+  std::cout << "skeleton: " << jointNodes.size() << " joints of " << nodeCount
+            << " nodes, " << result.skins.size() << " skins\n";
+
   return result;
 }
 
-std::vector<Mat4x4> getIverseMatrices(const tinygltf::Model &tinyModel)
+/// @brief key times of a sampler input accessor. samplers sharing an input
+/// accessor share the same timeline
+std::shared_ptr<Timeline> getTimeline(const tinygltf::Model &tinyModel, int accessor,
+                                      std::map<int, std::shared_ptr<Timeline>> &timelines)
 {
-  std::vector<Mat4x4> inverseMats;
-  inverseMats.resize(tinyModel.nodes.size(), identity());
+  auto found = timelines.find(accessor);
+  if (found != timelines.end())
+    return found->second;
 
-  const tinygltf::Skin &skin = tinyModel.skins[0];
+  const float *timeData = getData<float>(tinyModel, accessor);
+  int count = tinyModel.accessors[accessor].count;
 
-  if (skin.inverseBindMatrices < 1)
-  {
-    std::cout << "no inverse bind matrices found!\n";
-    return inverseMats;
-  }
-  const float *data = getData<float>(tinyModel, skin.inverseBindMatrices);
+  std::shared_ptr<Timeline> timeline = std::make_shared<Timeline>();
+  timeline->times.assign(timeData, timeData + count);
+  timelines[accessor] = timeline;
 
-  for (size_t j = 0; j < skin.joints.size(); j++)
-  {
-    int index = skin.joints[j];
-    inverseMats[index] = Mat4x4(&data[j * 16]).transpose();
-  }
-  return inverseMats;
+  return timeline;
 }
 
-Skeleton GLTFFile::getSkeleton()
+Interpolation getInterpolation(const std::string &interpolation)
 {
-  Skeleton result;
+  if (interpolation == "STEP")
+    return Interpolation::Constant;
+  if (interpolation == "CUBICSPLINE")
+    return Interpolation::Cubic;
 
-  result.jointNames = getJointNames(this->tinyModel);
-  result.inversePose = getIverseMatrices(this->tinyModel);
-  result.restPose = getRestPose(this->tinyModel);
+  return Interpolation::Linear;
+}
 
-  return result;
+/// @brief reads the output of a sampler into track. CUBICSPLINE outputs hold
+/// an in tangent, a value and an out tangent per key
+template <typename T, size_t N>
+void readTrack(const float *valueData, int count, Interpolation interpolation,
+               const std::shared_ptr<Timeline> &timeline, Track<T, N> &track)
+{
+  track.interpolation = interpolation;
+  track.timeline = timeline;
+  track.frames.assign(count, Frame<N>());
+
+  for (int j = 0; j < count; j++)
+  {
+    Frame<N> &frame = track.frames[j];
+    if (interpolation == Interpolation::Cubic)
+    {
+      const float *key = &valueData[j * 3 * N];
+      for (size_t k = 0; k < N; k++)
+      {
+        frame.m_in[k] = key[k];
+        frame.m_value[k] = key[N + k];
+        frame.m_out[k] = key[2 * N + k];
+      }
+    }
+    else
+    {
+      for (size_t k = 0; k < N; k++)
+      {
+        frame.m_value[k] = valueData[j * N + k];
+      }
+    }
+  }
 }
 
 void editTrack(const tinygltf::Model &tinyModel,
                const tinygltf::AnimationSampler &animSampler,
                const tinygltf::AnimationChannel &channel,
+               const std::shared_ptr<Timeline> &timeline,
                TransformTrack &track)
 {
-
-  const std::string path = channel.target_path;
-
-  const float *timeData = getData<float>(tinyModel, animSampler.input);
   const float *valueData = getData<float>(tinyModel, animSampler.output);
+  Interpolation interpolation = getInterpolation(animSampler.interpolation);
 
-  int count = tinyModel.accessors[animSampler.input].count;
+  int count = (int)timeline->size();
 
   // std::cout << "channel target: " << channel.target_node << "\n";
 
-  for (int j = 0; j < count; j++)
+  if (channel.target_path == "translation")
   {
-
-    if (channel.target_path == "translation")
-    {
-      Frame<3> frame = {
-          .m_value = {
-              valueData[j * 3 + 0],
-              valueData[j * 3 + 1],
-              valueData[j * 3 + 2]},
-          .m_in = {0.0f, 0.0f, 0.0f},
-          .m_out = {0.0f, 0.0f, 0.0f},
-          .time = timeData[j]};
-
-      track.getPosTrack().frames.push_back(frame);
-    }
-    else if (channel.target_path == "rotation")
-    {
-      Frame<4> frame = {
-          .m_value = {
-              valueData[j * 4 + 0],
-              valueData[j * 4 + 1],
-              valueData[j * 4 + 2],
-              valueData[j * 4 + 3]},
-
-          .m_in = {0.0f, 0.0f, 0.0f, 0.0f},
-          .m_out = {0.0f, 0.0f, 0.0f, 0.0f},
-          .time = timeData[j]};
-      track.getRotationTrack().frames.push_back(frame);
-    }
-    else if (channel.target_path == "scale")
-    {
-      Frame<3> frame = {
-          .m_value = {
-              valueData[j * 3 + 0],
-              valueData[j * 3 + 1],
-              valueData[j * 3 + 2]},
-          .time = timeData[j]
-
-      };
-      track.getScalingTrack().frames.push_back(frame);
-    }
+    readTrack(valueData, count, interpolation, timeline, track.getPosTrack());
+  }
+  else if (channel.target_path == "rotation")
+  {
+    readTrack(valueData, count, interpolation, timeline, track.getRotationTrack());
+  }
+  else if (channel.target_path == "scale")
+  {
+    readTrack(valueData, count, interpolation, timeline, track.getScalingTrack());
   }
 }
 
 Clip getClip(const tinygltf::Model &tinyModel,
-             const tinygltf::Animation &animation)
+             const tinygltf::Animation &animation,
+             const Skeleton &skeleton)
 {
   Clip clip;
+  std::map<int, std::shared_ptr<Timeline>> timelines;
+  int skipped = 0;
 
   for (size_t i = 0; i < animation.channels.size(); i++)
   {
     const tinygltf::AnimationChannel &channel = animation.channels[i];
     const tinygltf::AnimationSampler &animSampler = animation.samplers[channel.sampler];
 
-    if (channel.target_node < 0)
+    // tracks address skeleton joints, not nodes
+    int joint = skeleton.getJoint(channel.target_node);
+    if (joint < 0)
+    {
+      skipped++;
       continue;
+    }
+
+    std::shared_ptr<Timeline> timeline = getTimeline(tinyModel, animSampler.input, timelines);
 
     bool exists = false;
-    for (size_t joint = 0; joint < clip.size(); joint++)
+    for (size_t track = 0; track < clip.size(); track++)
     {
-      if (clip.getTrack(joint).getId() == channel.target_node)
+      if (clip.getTrack(track).getId() == (size_t)joint)
       {
-        editTrack(tinyModel, animSampler, channel, clip.getTrack(joint));
+        editTrack(tinyModel, animSampler, channel, timeline, clip.getTrack(track));
         exists = true;
         break;
       }
@@ -628,25 +792,32 @@ Clip getClip(const tinygltf::Model &tinyModel,
     if (!exists)
     {
       TransformTrack jointTrack;
-      jointTrack.setId(channel.target_node);
-      editTrack(tinyModel, animSampler, channel, jointTrack);
+      jointTrack.setId(joint);
+      editTrack(tinyModel, animSampler, channel, timeline, jointTrack);
       clip.getTracks().push_back(jointTrack);
       clip.SetName(animation.name);
     }
   }
 
+  if (skipped > 0)
+  {
+    std::cout << "clip " << animation.name << ": " << skipped
+              << " channels target nodes outside the skeleton\n";
+  }
+
   // std::cout << "number of tracks: " << clip.size() << std::endl;
+  clip.shareTimelines();
   clip.ReCalculateDuartion();
   return clip;
 }
 
-std::vector<Clip> GLTFFile::getClips()
+std::vector<Clip> GLTFFile::getClips(const Skeleton &skeleton)
 {
   std::vector<Clip> clips;
   for (size_t i = 0; i < this->tinyModel.animations.size(); i++)
   {
     const tinygltf::Animation &animation = this->tinyModel.animations[i];
-    clips.push_back(getClip(this->tinyModel, animation));
+    clips.push_back(getClip(this->tinyModel, animation, skeleton));
   }
 
   return clips;
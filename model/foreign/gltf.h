@@ -4,22 +4,43 @@
 #include <iostream>
 #include <vector>
 #include "../animation/skeleton.h"
+#include "../animation/compressedTrack.h"
 #include "tiny_gltf.h"
 
+/// @brief options applied to the animation data while importing
+struct GLTFImportSettings
+{
+  // drop keys reconstructible within reductionTolerance (model units)
+  bool reduceKeys{false};
+  float reductionTolerance{1e-3f};
+  // quantize clip keyframes within the compression error budget
+  bool compressClips{false};
+  CompressionSettings compression;
+  // resample clips at bakeRate samples per second, replaces compression
+  bool bakeClips{false};
+  float bakeRate{30.0f};
+  // false keeps meshes on the cpu and skips textures, for tools running
+  // without a gl context
+  bool upload{true};
+  // prints what reduction, optimization and compression did to each clip
+  bool verbose{true};
+};
+
 class GLTFFile
 {
 public:
-  GLTFFile(std::string &path);
+  GLTFFile(std::string &path, const GLTFImportSettings &settings = GLTFImportSettings());
   ~GLTFFile() {}
 
   void populateModel(class Model &model);
 
 private:
   tinygltf::Model tinyModel;
+  GLTFImportSettings settings;
 
-  std::vector<struct Mesh> getMeshes();
+  std::vector<struct Mesh> getMeshes(const Skeleton &skeleton);
   std::vector<class Texture> getTextures();
-  std::vector<class Clip> getClips();
+  std::vector<class Clip> getClips(const Skeleton &skeleton);
   Skeleton getSkeleton();
 };
 
@@ -2,11 +2,40 @@
 
 #include "../external/glad/glad.h"
 #include <SDL2/SDL_opengl.h>
+#include <algorithm>
+#include <cmath>
+
+// meshes spanning this share of the model's largest extent are occluders
+static const float occluderShare = 0.3f;
+// cells along the model's largest extent occluders are simplified on.
+// occluders are inset by a cell diagonal, finer cells keep more of them
+static const int occluderCells = 32;
+
+// box around a box moved by m, from its center and half extents
+static BoundingBox transformBounds(const BoundingBox &box, const Mat4x4 &m)
+{
+  Vector3f center = (box.minPt + box.maxPt) * 0.5f;
+  Vector3f extent = (box.maxPt - box.minPt) * 0.5f;
+
+  BoundingBox moved;
+  for (int r = 0; r < 3; ++r)
+  {
+    float c = m.rc[r][0] * center.x + m.rc[r][1] * center.y + m.rc[r][2] * center.z + m.rc[r][3];
+    float e = fabsf(m.rc[r][0]) * extent.x + fabsf(m.rc[r][1]) * extent.y + fabsf(m.rc[r][2]) * extent.z;
+    moved.minPt.v[r] = c - e;
+    moved.maxPt.v[r] = c + e;
+  }
+  return moved;
+}
 
 Model::Model()
     : animController(nullptr),
       transform(new Transform()),
-      factor(Vector3f(1.0)) {}
+      factor(Vector3f(1.0)),
+      instanceBuffer(0),
+      boneBuffer(0),
+      drawBuffer(0),
+      commandBuffer(0) {}
 
 void Model::translate(Vector3f pos) { this->transform->translation = pos; }
 
@@ -34,24 +63,604 @@ void Model::normalize()
   factor = Vector3f(2.0f / maxSide);
 }
 
-void Model::render(Shader &shader)
+void Model::render(Shader &skinned, Shader &rigid)
+{
+  Mat4x4 transform = this->get_transform();
+
+  skinned.use();
+  skinned.updateMat4("transform", transform);
+
+  int boundSkin = -1;
+  for (auto &mesh : meshes)
+  {
+    if (mesh.skin == -1)
+    {
+      continue;
+    }
+
+    // meshes sharing a skin share its palette upload
+    if (this->animController != nullptr && mesh.skin != boundSkin)
+    {
+      this->animController->getPalette(mesh.skin, this->palette);
+      if (!this->palette.empty())
+      {
+        skinned.updateMat4Array("boneMats", this->palette.data(), (int)this->palette.size());
+      }
+      boundSkin = mesh.skin;
+    }
+
+    mesh.render(skinned);
+  }
+
+  // rigid meshes only need the matrix of the joint they are attached to
+  rigid.use();
+  for (auto &mesh : meshes)
+  {
+    if (mesh.skin != -1)
+    {
+      continue;
+    }
+
+    Mat4x4 world = transform;
+    if (this->animController != nullptr && mesh.node != -1)
+    {
+      world = transform * this->animController->getJointMatrix(mesh.node);
+    }
+    rigid.updateMat4("transform", world);
+
+    mesh.render(rigid);
+  }
+}
+
+/// @brief features of the variant that draws the mesh
+/// @param preskinned the mesh was skinned by a SkinningPass
+static ShaderFeatures getFeatures(const Mesh &mesh, const ShaderFeatures &base,
+                                  bool preskinned = false)
+{
+  ShaderFeatures features = base;
+  features.skinned = mesh.skin != -1 && !preskinned;
+  features.boneInfluences = features.skinned ? mesh.influences : 4;
+  features.baseTexture = (mesh.material.flags & MATERIAL_BASE_TEXTURE) != 0 ? 1 : 0;
+  features.metallicMap = (mesh.material.flags & MATERIAL_METALLIC_MAP) != 0 ? 1 : 0;
+  return features;
+}
+
+void Model::prepareShaders(ShaderVariants &variants, const ShaderFeatures &base)
 {
   for (auto &mesh : meshes)
   {
-    int bIdx = mesh.material.baseTex;
-    if (bIdx != -1)
+    variants.prepare(getFeatures(mesh, base));
+    if (mesh.skin != -1)
+    {
+      // skinned meshes draw rigid after a skinning pass
+      variants.prepare(getFeatures(mesh, base, true));
+    }
+  }
+}
+
+void Model::updateSkinPalettes()
+{
+  Skeleton *skeleton = this->animController != nullptr ? this->animController->getSkeleton() : nullptr;
+  this->skinPalettes.resize(skeleton != nullptr ? skeleton->skins.size() : 0);
+  for (size_t s = 0; s < this->skinPalettes.size(); ++s)
+  {
+    this->animController->getPalette(s, this->skinPalettes[s]);
+  }
+}
+
+bool Model::isPreskinned(const Mesh &mesh)
+{
+  return mesh.skin != -1 && mesh.pooled && (size_t)mesh.skin < this->skinPalettes.size() &&
+         !this->skinPalettes[mesh.skin].empty();
+}
+
+void Model::skin(SkinningPass &pass, bool onCpu)
+{
+  this->updateSkinPalettes();
+
+  if (onCpu)
+  {
+    if (this->cpuSkinning.size() != meshes.size())
     {
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, this->textures[bIdx].id);
+      this->cpuSkinning.assign(meshes.size(), CpuSkinning());
+      for (size_t i = 0; i < meshes.size(); ++i)
+      {
+        if (meshes[i].skin != -1)
+        {
+          this->cpuSkinning[i].setMesh(meshes[i]);
+        }
+      }
     }
 
-    int mIdx = mesh.material.metallicMap;
-    if (mIdx != -1)
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+      if (this->isPreskinned(meshes[i]))
+      {
+        const std::vector<Mat4x4> &palette = this->skinPalettes[meshes[i].skin];
+        if (this->cpuSkinning[i].skin(palette.data(), (int)palette.size(), this->skinnedVertices))
+        {
+          pass.upload(meshes[i], this->skinnedVertices.data());
+        }
+      }
+    }
+    return;
+  }
+
+  pass.begin();
+  for (auto &mesh : meshes)
+  {
+    if (this->isPreskinned(mesh))
+    {
+      const std::vector<Mat4x4> &palette = this->skinPalettes[mesh.skin];
+      pass.skin(mesh, palette.data(), (int)palette.size());
+    }
+  }
+  pass.end();
+}
+
+void Model::queue(RenderQueue &queue, ShaderVariants &variants, const ShaderFeatures &base,
+                  const Vector3f &eye, const SkinningPass *skinning)
+{
+  Mat4x4 transform = this->get_transform();
+  Vector3f position(transform.rc[0][3], transform.rc[1][3], transform.rc[2][3]);
+  float depth = (position - eye).mag();
+
+  // skin already took the palettes of this frame
+  if (skinning == nullptr)
+  {
+    this->updateSkinPalettes();
+  }
+
+  for (auto &mesh : meshes)
+  {
+    RenderItem item;
+    item.mesh = &mesh;
+    item.material = &mesh.material;
+    // material textures are layers of the texture arrays, nothing to bind
+    item.textures[0] = 0;
+    item.textures[1] = 0;
+    item.palette = nullptr;
+    item.paletteSize = 0;
+    item.vao = 0;
+
+    if (skinning != nullptr && this->isPreskinned(mesh))
+    {
+      // already in model space, drawn like a rigid mesh at the model
+      item.shader = variants.get(getFeatures(mesh, base, true));
+      item.transform = transform;
+      item.vao = skinning->VAO;
+      queue.push(item, depth);
+      continue;
+    }
+
+    item.shader = variants.get(getFeatures(mesh, base));
+
+    if (mesh.skin != -1)
+    {
+      item.transform = transform;
+      if ((size_t)mesh.skin < this->skinPalettes.size() && !this->skinPalettes[mesh.skin].empty())
+      {
+        item.palette = this->skinPalettes[mesh.skin].data();
+        item.paletteSize = (int)this->skinPalettes[mesh.skin].size();
+      }
+    }
+    else
+    {
+      item.transform = transform;
+      if (this->animController != nullptr && mesh.node != -1)
+      {
+        item.transform = transform * this->animController->getJointMatrix(mesh.node);
+      }
+    }
+
+    queue.push(item, depth);
+  }
+}
+
+void Model::renderInstanced(Shader &shader, AnimationTexture &animation, int count)
+{
+  shader.use();
+  animation.bind(3);
+
+  for (auto &mesh : meshes)
+  {
+    if (mesh.skin == -1)
+    {
+      continue;
+    }
+
+    shader.updateInt("paletteOffset", animation.getSkinOffset(mesh.skin));
+    mesh.renderInstanced(shader, count);
+  }
+}
+
+size_t Model::addInstance(const Transform &transform, const Color3f &tint)
+{
+  ModelInstance instance;
+  instance.transform = transform;
+  instance.tint = tint;
+
+  if (this->animController != nullptr)
+  {
+    instance.controller = new Controller();
+    instance.controller->setSkeleton(this->animController->getSkeleton());
+    for (size_t i = 0; i < this->animController->clipCount(); ++i)
+    {
+      instance.controller->addClip(this->animController->getClip(i));
+    }
+    instance.controller->setPoseCache(this->animController->getPoseCache());
+  }
+
+  this->instances.push_back(instance);
+  return this->instances.size() - 1;
+}
+
+ModelInstance &Model::getInstance(size_t index) { return this->instances[index]; }
+
+size_t Model::instanceCount() const { return this->instances.size(); }
+
+void Model::clearInstances()
+{
+  for (auto &instance : this->instances)
+  {
+    if (instance.controller != nullptr)
+    {
+      // the clips belong to the model's controller, clean would delete them
+      while (instance.controller->clipCount() > 0)
+      {
+        instance.controller->removeClip(instance.controller->clipCount() - 1);
+      }
+      instance.controller->clean();
+      delete instance.controller;
+    }
+  }
+  this->instances.clear();
+  this->instanceBlocks.clear();
+}
+
+void Model::updateInstances(float deltaTime)
+{
+  for (auto &instance : this->instances)
+  {
+    if (instance.controller != nullptr)
+    {
+      instance.controller->update(deltaTime);
+    }
+  }
+  this->updateInstanceBlocks(this->updatePaletteLayout());
+}
+
+void Model::updateInstanceBlocks(int stride)
+{
+  this->instanceBlocks.assign(this->instances.size() * stride, identity());
+  for (size_t i = 0; i < this->instances.size(); ++i)
+  {
+    ModelInstance &instance = this->instances[i];
+    if (instance.controller != nullptr)
     {
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, this->textures[mIdx].id);
+      this->writePalettes(*instance.controller, this->instanceBlocks.data() + i * stride);
+    }
+  }
+}
+
+void Model::renderInstances(Shader &shader)
+{
+  if (this->instances.empty())
+  {
+    return;
+  }
+
+  int stride = this->updatePaletteLayout();
+  // copies added since the last updateInstances have no block yet
+  if (this->instanceBlocks.size() != this->instances.size() * stride)
+  {
+    this->updateInstanceBlocks(stride);
+  }
+
+  Mat4x4 transform = this->get_transform();
+  size_t count = 0;
+  for (auto &instance : this->instances)
+  {
+    count += instance.visible ? 1 : 0;
+  }
+  if (count == 0)
+  {
+    return;
+  }
+  this->bones.resize(count * stride);
+  this->instanceData.resize(count);
+
+  // hidden copies are left out, the visible ones are packed from the start
+  size_t i = 0;
+  for (size_t c = 0; c < this->instances.size(); ++c)
+  {
+    const ModelInstance &instance = this->instances[c];
+    if (!instance.visible)
+    {
+      continue;
+    }
+    const Mat4x4 *block = this->instanceBlocks.data() + c * stride;
+    std::copy(block, block + stride, this->bones.data() + i * stride);
+
+    InstanceData &data = this->instanceData[i];
+    data.transform = transform * instance.transform.get();
+    data.tint[0] = instance.tint.x;
+    data.tint[1] = instance.tint.y;
+    data.tint[2] = instance.tint.z;
+    data.tint[3] = 1.0f;
+    data.paletteOffset = (int)i * stride;
+    i++;
+  }
+
+  if (this->instanceBuffer == 0)
+  {
+    glCreateBuffers(1, &this->instanceBuffer);
+  }
+  if (this->boneBuffer == 0)
+  {
+    glCreateBuffers(1, &this->boneBuffer);
+  }
+  glNamedBufferData(this->instanceBuffer, count * sizeof(InstanceData), this->instanceData.data(),
+                    GL_STREAM_DRAW);
+  glNamedBufferData(this->boneBuffer, this->bones.size() * sizeof(Mat4x4), this->bones.data(),
+                    GL_STREAM_DRAW);
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->instanceBuffer);
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->boneBuffer);
+
+  shader.use();
+  for (size_t m = 0; m < this->meshes.size(); ++m)
+  {
+    Mesh &mesh = this->meshes[m];
+    shader.updateInt("paletteSlot", this->paletteSlots[m]);
+    shader.updateInt("rigid", mesh.skin == -1);
+    mesh.renderInstanced(shader, (int)count);
+  }
+}
+
+void Model::cullInstances(OcclusionCuller &culler, const Vector3f &eye, int occluderCopies)
+{
+  if (this->paletteBounds.size() != this->meshes.size())
+  {
+    this->prepareCulling();
+  }
+
+  int stride = this->updatePaletteLayout();
+  Mat4x4 transform = this->get_transform();
+  size_t count = this->instances.size();
+  if (this->instanceBlocks.size() != count * stride)
+  {
+    this->updateInstanceBlocks(stride);
+  }
+  this->cullBounds.assign(count, BoundingBox());
+  this->cullOrder.clear();
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    ModelInstance &instance = this->instances[i];
+    const Mat4x4 *block = this->instanceBlocks.data() + i * stride;
+
+    BoundingBox &bounds = this->cullBounds[i];
+    for (size_t m = 0; m < this->meshes.size(); ++m)
+    {
+      for (size_t e = 0; e < this->paletteBounds[m].size(); ++e)
+      {
+        const BoundingBox &box = this->paletteBounds[m][e];
+        if (box.minPt.x > box.maxPt.x)
+        {
+          continue;
+        }
+        BoundingBox moved = transformBounds(box, block[this->paletteSlots[m] + e]);
+        bounds.update(moved.minPt);
+        bounds.update(moved.maxPt);
+      }
+    }
+
+    Mat4x4 world = transform * instance.transform.get();
+    Vector3f center = (bounds.minPt + bounds.maxPt) * 0.5f;
+    Vector3f position(world.rc[0][0] * center.x + world.rc[0][1] * center.y + world.rc[0][2] * center.z + world.rc[0][3],
+                      world.rc[1][0] * center.x + world.rc[1][1] * center.y + world.rc[1][2] * center.z + world.rc[1][3],
+                      world.rc[2][0] * center.x + world.rc[2][1] * center.y + world.rc[2][2] * center.z + world.rc[2][3]);
+    this->cullOrder.push_back(std::make_pair((position - eye).mag(), i));
+  }
+
+  // the nearest copies hide the most, only they are rasterized
+  std::sort(this->cullOrder.begin(), this->cullOrder.end());
+  size_t occluding = std::min(count, (size_t)std::max(occluderCopies, 0));
+  for (size_t k = 0; k < occluding; ++k)
+  {
+    size_t i = this->cullOrder[k].second;
+    const Mat4x4 *block = this->instanceBlocks.data() + i * stride;
+    Mat4x4 world = transform * this->instances[i].transform.get();
+    for (size_t o = 0; o < this->occluders.size(); ++o)
+    {
+      size_t m = this->occluderMeshes[o];
+      int paletteSize = this->meshes[m].skin == -1 ? 1 : (int)this->paletteBounds[m].size();
+      if (this->occluderSkinning[o].skin(block + this->paletteSlots[m], paletteSize, this->occluderVertices))
+      {
+        culler.addOccluder(this->occluderVertices, this->occluders[o].indices, world);
+      }
+    }
+  }
+  culler.rasterize();
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    ModelInstance &instance = this->instances[i];
+    instance.visible = culler.isVisible(this->cullBounds[i], transform * instance.transform.get());
+  }
+}
+
+void Model::prepareCulling()
+{
+  BoundingBox modelBounds;
+  for (auto &mesh : this->meshes)
+  {
+    BoundingBox meshBounds = mesh.getBoundingBox();
+    modelBounds.update(meshBounds.minPt);
+    modelBounds.update(meshBounds.maxPt);
+  }
+  Vector3f modelExtent = modelBounds.maxPt - modelBounds.minPt;
+  float largest = std::max({modelExtent.x, modelExtent.y, modelExtent.z});
+
+  Skeleton *skeleton = this->animController != nullptr ? this->animController->getSkeleton() : nullptr;
+  this->paletteBounds.assign(this->meshes.size(), std::vector<BoundingBox>());
+  this->occluders.clear();
+  this->occluderMeshes.clear();
+  for (size_t m = 0; m < this->meshes.size(); ++m)
+  {
+    Mesh &mesh = this->meshes[m];
+    BoundingBox meshBounds = mesh.getBoundingBox();
+    std::vector<BoundingBox> &bounds = this->paletteBounds[m];
+
+    if (mesh.skin == -1)
+    {
+      bounds.push_back(meshBounds);
+    }
+    else if (skeleton != nullptr && (size_t)mesh.skin < skeleton->skins.size())
+    {
+      bounds.resize(skeleton->skins[mesh.skin].joints.size());
+      for (const Vertex &vertex : mesh.vertices)
+      {
+        for (int i = 0; i < 4; ++i)
+        {
+          if (vertex.weights[i] > 0.0f && vertex.joints[i] >= 0 && (size_t)vertex.joints[i] < bounds.size())
+          {
+            bounds[vertex.joints[i]].update(vertex.pos);
+          }
+        }
+      }
+    }
+
+    Vector3f extent = meshBounds.maxPt - meshBounds.minPt;
+    if (!mesh.indices.empty() && std::max({extent.x, extent.y, extent.z}) >= occluderShare * largest)
+    {
+      this->occluders.push_back(OcclusionCuller::simplify(mesh, modelBounds, occluderCells));
+      this->occluderMeshes.push_back(m);
+    }
+  }
+
+  this->occluderSkinning.assign(this->occluders.size(), CpuSkinning());
+  for (size_t o = 0; o < this->occluders.size(); ++o)
+  {
+    this->occluderSkinning[o].setMesh(this->occluders[o]);
+  }
+}
+
+void Model::renderIndirect(Shader &shader)
+{
+  this->drawOrder.clear();
+  for (size_t m = 0; m < this->meshes.size(); ++m)
+  {
+    if (this->meshes[m].pooled)
+    {
+      this->drawOrder.push_back(m);
+    }
+  }
+  if (this->drawOrder.empty())
+  {
+    return;
+  }
+
+  int stride = this->updatePaletteLayout();
+  this->bones.assign(std::max(stride, 1), identity());
+  if (this->animController != nullptr)
+  {
+    this->writePalettes(*this->animController, this->bones.data());
+  }
+
+  Mat4x4 transform = this->get_transform();
+  size_t count = this->drawOrder.size();
+  this->commands.resize(count);
+  this->drawData.resize(count);
+  for (size_t k = 0; k < count; ++k)
+  {
+    Mesh &mesh = this->meshes[this->drawOrder[k]];
+
+    DrawElementsIndirectCommand &command = this->commands[k];
+    command.count = (unsigned int)mesh.indices.size();
+    command.instanceCount = 1;
+    command.firstIndex = mesh.firstIndex;
+    command.baseVertex = mesh.baseVertex;
+    command.baseInstance = (unsigned int)k;
+
+    DrawData &data = this->drawData[k];
+    data.transform = transform;
+    data.paletteOffset = this->paletteSlots[this->drawOrder[k]];
+    data.rigid = mesh.skin == -1;
+    data.material = mesh.material.slot;
+    data.padding = 0;
+  }
+
+  if (this->drawBuffer == 0)
+  {
+    glCreateBuffers(1, &this->drawBuffer);
+    glCreateBuffers(1, &this->commandBuffer);
+  }
+  if (this->boneBuffer == 0)
+  {
+    glCreateBuffers(1, &this->boneBuffer);
+  }
+  glNamedBufferData(this->boneBuffer, this->bones.size() * sizeof(Mat4x4), this->bones.data(),
+                    GL_STREAM_DRAW);
+  glNamedBufferData(this->drawBuffer, count * sizeof(DrawData), this->drawData.data(),
+                    GL_STREAM_DRAW);
+  glNamedBufferData(this->commandBuffer, count * sizeof(DrawElementsIndirectCommand),
+                    this->commands.data(), GL_STREAM_DRAW);
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->boneBuffer);
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->drawBuffer);
+  GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+
+  shader.use();
+  GLState::bindVertexArray(this->meshes[this->drawOrder[0]].VAO);
+
+  // textures are array layers picked through the material buffer, so every
+  // pooled mesh goes out in the same call
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)count, 0);
+}
+
+int Model::updatePaletteLayout()
+{
+  Skeleton *skeleton = this->animController != nullptr ? this->animController->getSkeleton() : nullptr;
+  this->paletteSkins.clear();
+  int stride = 0;
+  if (skeleton != nullptr)
+  {
+    for (auto &skin : skeleton->skins)
+    {
+      this->paletteSkins.push_back(stride);
+      stride += (int)skin.joints.size();
+    }
+  }
+
+  this->paletteSlots.assign(this->meshes.size(), 0);
+  for (size_t m = 0; m < this->meshes.size(); ++m)
+  {
+    int skin = this->meshes[m].skin;
+    if (skin == -1)
+    {
+      this->paletteSlots[m] = stride++;
+    }
+    else if ((size_t)skin < this->paletteSkins.size())
+    {
+      this->paletteSlots[m] = this->paletteSkins[skin];
+    }
+  }
+  return stride;
+}
+
+void Model::writePalettes(Controller &controller, Mat4x4 *block)
+{
+  for (size_t s = 0; s < this->paletteSkins.size(); ++s)
+  {
+    controller.getPalette(s, this->palette);
+    std::copy(this->palette.begin(), this->palette.end(), block + this->paletteSkins[s]);
+  }
+  for (size_t m = 0; m < this->meshes.size(); ++m)
+  {
+    if (this->meshes[m].skin == -1 && this->meshes[m].node != -1)
+    {
+      block[this->paletteSlots[m]] = controller.getJointMatrix(this->meshes[m].node);
     }
-    mesh.render(shader);
   }
 }
 
@@ -59,6 +668,12 @@ void Model::clean()
 {
   delete transform;
 
+  this->clearInstances();
+  glDeleteBuffers(1, &this->instanceBuffer);
+  glDeleteBuffers(1, &this->boneBuffer);
+  glDeleteBuffers(1, &this->drawBuffer);
+  glDeleteBuffers(1, &this->commandBuffer);
+
   if (this->animController != nullptr)
   {
     this->animController->clean();
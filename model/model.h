@@ -17,6 +17,45 @@ enum ModelType
   ModelOBJ,
 };
 
+/// @brief per copy data read by shaders/instanced.vert from the storage
+/// buffer at binding 0, laid out to match its std430 block
+struct InstanceData
+{
+  Mat4x4 transform;
+  float tint[4];
+  // first matrix of the copy in the bone buffer
+  int paletteOffset;
+  int padding[3];
+};
+
+/// @brief per draw data read by shaders/indirect.vert at gl_BaseInstance,
+/// laid out to match its std430 block
+struct DrawData
+{
+  Mat4x4 transform;
+  // first matrix of the draw in the bone buffer
+  int paletteOffset;
+  int rigid;
+  // slot of the mesh's material in the MaterialBuffer
+  int material;
+  int padding;
+};
+
+/// @brief copy of a model drawn by Model::renderInstances
+struct ModelInstance
+{
+  // placement of the copy in model space, the model's transform still
+  // applies on top
+  Transform transform;
+  Color3f tint{1.0};
+  // plays the model's clips independently of the other copies, nullptr for
+  // models without animation
+  Controller *controller{nullptr};
+  // false while cullInstances finds the copy hidden, renderInstances then
+  // skips it
+  bool visible{true};
+};
+
 class Model
 {
 public:
@@ -29,7 +68,51 @@ public:
 
   void normalize();
 
-  void render(Shader &);
+  /// @brief draws skinned meshes with the skinned shader and rigid meshes
+  /// with the rigid shader, placed by the joint they are attached to
+  void render(Shader &skinned, Shader &rigid);
+  /// @brief records a draw per mesh with the variant matching its skinning
+  /// and material, sorted by distance to eye within their state group
+  /// @param base features shared by every variant, like the light count
+  /// @param skinning pass that skinned the model this frame, its meshes
+  /// then draw as rigid ones. nullptr skins them in the vertex shader
+  void queue(RenderQueue &queue, ShaderVariants &variants, const ShaderFeatures &base,
+             const Vector3f &eye, const SkinningPass *skinning = nullptr);
+  /// @brief skins the pooled skinned meshes into the pass with the
+  /// current pose, once for every pass of the frame that queues them
+  /// @param onCpu skins with CpuSkinning and uploads the result instead
+  void skin(SkinningPass &pass, bool onCpu = false);
+  /// @brief starts compiling the variants queue will use, call once the
+  /// materials are in the material buffer
+  void prepareShaders(ShaderVariants &variants, const ShaderFeatures &base);
+  /// @brief draws count copies of the skinned meshes animated from a baked
+  /// animation texture, the shader reads the instances from its storage
+  /// buffer. rigid meshes are skipped
+  void renderInstanced(Shader &shader, AnimationTexture &animation, int count);
+
+  /// @brief adds a copy drawn by renderInstances, with a controller sharing
+  /// the model's skeleton, clips and pose cache
+  /// @return instance index
+  size_t addInstance(const Transform &transform, const Color3f &tint = Color3f(1.0));
+  ModelInstance &getInstance(size_t index);
+  size_t instanceCount() const;
+  void clearInstances();
+  /// @brief advances the copies' animation and writes their palettes,
+  /// which cullInstances and renderInstances share for the frame
+  void updateInstances(float deltaTime);
+  /// @brief draws every copy with one instanced draw per mesh. the palettes
+  /// of all copies share one bone buffer, each copy's block holds the
+  /// palette of every skin followed by the joint matrix of every rigid mesh
+  void renderInstances(Shader &shader);
+  /// @brief rasterizes simplified copies of the large meshes of the
+  /// nearest copies into the culler, then hides the copies whose posed
+  /// bounds are outside the view or behind them
+  /// @param occluderCopies copies rasterized, nearest to eye first
+  void cullInstances(OcclusionCuller &culler, const Vector3f &eye, int occluderCopies);
+  /// @brief draws the pooled meshes (see GeometryPool) with a single
+  /// glMultiDrawElementsIndirect. transforms, palettes and materials are
+  /// fetched in the shader through the draw's base instance
+  void renderIndirect(Shader &shader);
   void clean();
 
   Mat4x4 get_transform();
@@ -41,6 +124,66 @@ public:
 private:
   class Transform *transform;
   Vector3f factor;
+  // scratch space for the skinning matrices of one skin
+  std::vector<Mat4x4> palette;
+  // palette of every skin recorded by queue, alive until the queue submits
+  std::vector<std::vector<Mat4x4>> skinPalettes;
+
+  // streams of every mesh for skin on the cpu, made on first use
+  std::vector<CpuSkinning> cpuSkinning;
+  std::vector<SkinnedVertex> skinnedVertices;
+
+  /// @brief fills skinPalettes with the current pose
+  void updateSkinPalettes();
+  /// @brief true if skin found a palette for the mesh
+  bool isPreskinned(const Mesh &mesh);
+
+  std::vector<ModelInstance> instances;
+  // palette block of every copy, laid out by updatePaletteLayout
+  std::vector<Mat4x4> instanceBlocks;
+  /// @brief writes instanceBlocks from the copies' current poses
+  /// @param stride matrices in a block
+  void updateInstanceBlocks(int stride);
+  // storage buffers of renderInstances, refilled every draw
+  std::vector<InstanceData> instanceData;
+  std::vector<Mat4x4> bones;
+  unsigned int instanceBuffer;
+  unsigned int boneBuffer;
+
+  // pooled meshes and the matching draws of renderIndirect
+  std::vector<size_t> drawOrder;
+  std::vector<DrawData> drawData;
+  std::vector<DrawElementsIndirectCommand> commands;
+  unsigned int drawBuffer;
+  unsigned int commandBuffer;
+
+  // layout of a block of the bone buffer: the palette of every skin, then
+  // the joint matrix of every rigid mesh
+  std::vector<int> paletteSkins;
+  // matrix of every mesh within a block
+  std::vector<int> paletteSlots;
+  /// @return matrices in a block
+  int updatePaletteLayout();
+  /// @brief writes the controller's matrices to a block laid out by
+  /// updatePaletteLayout
+  void writePalettes(Controller &controller, Mat4x4 *block);
+
+  // simplified large meshes the copies hide each other with, and the
+  // index of their mesh
+  std::vector<Mesh> occluders;
+  std::vector<size_t> occluderMeshes;
+  std::vector<CpuSkinning> occluderSkinning;
+  std::vector<SkinnedVertex> occluderVertices;
+  // bind pose bounds of the vertices each palette entry of a mesh moves,
+  // a single entry for rigid meshes. skinned vertices are blends of their
+  // joints' matrices, so a posed mesh lies within its entries' boxes moved
+  // by their matrices
+  std::vector<std::vector<BoundingBox>> paletteBounds;
+  // posed bounds and distance of every copy for cullInstances
+  std::vector<BoundingBox> cullBounds;
+  std::vector<std::pair<float, size_t>> cullOrder;
+  /// @brief builds occluders and paletteBounds on the first cullInstances
+  void prepareCulling();
 };
 
 #endif
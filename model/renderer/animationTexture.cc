@@ -0,0 +1,168 @@
+#include "animationTexture.h"
+#include "../animation/clip.h"
+#include "../animation/controller.h"
+#include "../animation/pose.h"
+#include "../animation/skeleton.h"
+#include "../animation/transformTrack.h"
+#include "../animation/compressedTrack.h"
+#include "glState.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void AnimationTexture::bake(Controller &controller, float rate)
+{
+  Skeleton *skeleton = controller.getSkeleton();
+  if (skeleton == nullptr)
+  {
+    std::cout << "animation texture: controller has no skeleton" << std::endl;
+    return;
+  }
+
+  this->clips.clear();
+  this->texels.clear();
+  this->skinOffsets.clear();
+  this->joints = 0;
+  for (auto &skin : skeleton->skins)
+  {
+    this->skinOffsets.push_back(this->joints);
+    this->joints += (int)skin.joints.size();
+  }
+
+  std::vector<Mat4x4> globals;
+  size_t rowSize = (size_t)this->joints * 12;
+  int rows = 0;
+
+  for (size_t c = 0; c < controller.clipCount(); ++c)
+  {
+    Clip &clip = *controller.getClip(c);
+
+    ClipRange range;
+    range.firstRow = rows;
+    range.duration = clip.GetDuration();
+    int intervals = (int)std::max(1.0f, ceilf(range.duration * rate));
+    range.frameCount = intervals + 1;
+    range.rate = range.duration > 0.0f ? (float)intervals / range.duration : 0.0f;
+
+    // the last row holds the end of the clip, not its wrapped start
+    bool looping = clip.GetLooping();
+    clip.SetLooping(false);
+
+    Pose &base = clip.getBasePose();
+    Pose pose = base.size() == skeleton->restPose.size() ? base : skeleton->restPose;
+
+    this->texels.resize(this->texels.size() + rowSize * range.frameCount);
+    for (int i = 0; i < range.frameCount; ++i)
+    {
+      float time = clip.GetStartTime() + (float)i / (float)intervals * range.duration;
+      clip.sample(pose, time);
+      pose.getMatrixPalette(globals);
+
+      float *row = &this->texels[(size_t)(rows + i) * rowSize];
+      for (size_t s = 0; s < skeleton->skins.size(); ++s)
+      {
+        const Skin &skin = skeleton->skins[s];
+        for (size_t j = 0; j < skin.joints.size(); ++j)
+        {
+          Mat4x4 m = globals[skin.joints[j]] * skin.inverseBindMatrices[j];
+          float *texel = row + (this->skinOffsets[s] + j) * 12;
+          for (int r = 0; r < 3; ++r)
+          {
+            for (int k = 0; k < 4; ++k)
+            {
+              texel[r * 4 + k] = m.rc[r][k];
+            }
+          }
+        }
+      }
+    }
+
+    clip.SetLooping(looping);
+    rows += range.frameCount;
+    this->clips.push_back(range);
+  }
+
+  this->width = this->joints * 3;
+  this->height = rows;
+}
+
+bool AnimationTexture::upload()
+{
+  if (this->width == 0 || this->height == 0)
+  {
+    std::cout << "animation texture: nothing baked" << std::endl;
+    return false;
+  }
+
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  if (this->width > maxSize || this->height > maxSize)
+  {
+    std::cout << "animation texture: " << this->width << "x" << this->height
+              << " is over the max texture size (" << maxSize << ")" << std::endl;
+    return false;
+  }
+
+  glCreateTextures(GL_TEXTURE_2D, 1, &this->id);
+  glTextureStorage2D(this->id, 1, GL_RGBA32F, this->width, this->height);
+  glTextureSubImage2D(this->id, 0, 0, 0, this->width, this->height, GL_RGBA, GL_FLOAT,
+                      this->texels.data());
+
+  // read with texelFetch, frames are blended in the shader
+  glTextureParameteri(this->id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTextureParameteri(this->id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTextureParameteri(this->id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTextureParameteri(this->id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  this->texels.clear();
+  this->texels.shrink_to_fit();
+  return true;
+}
+
+void AnimationTexture::bind(int unit) { GLState::bindTexture(unit, this->id); }
+
+size_t AnimationTexture::clipCount() const { return this->clips.size(); }
+
+const AnimationTexture::ClipRange &AnimationTexture::getClip(size_t index) const
+{
+  return this->clips[index];
+}
+
+int AnimationTexture::getSkinOffset(size_t skin) const
+{
+  if (skin < this->skinOffsets.size())
+  {
+    return this->skinOffsets[skin];
+  }
+  return 0;
+}
+
+AnimationInstance AnimationTexture::getInstance(const Mat4x4 &transform, size_t clip, float offset) const
+{
+  AnimationInstance instance;
+  instance.transform = transform;
+  instance.firstRow = 0.0f;
+  instance.frameCount = 1.0f;
+  instance.timeOffset = offset;
+  instance.rate = 0.0f;
+
+  if (clip < this->clips.size())
+  {
+    const ClipRange &range = this->clips[clip];
+    instance.firstRow = (float)range.firstRow;
+    instance.frameCount = (float)range.frameCount;
+    instance.rate = range.rate;
+  }
+  return instance;
+}
+
+size_t AnimationTexture::memory() const
+{
+  return (size_t)this->width * this->height * 4 * sizeof(float);
+}
+
+void AnimationTexture::clean()
+{
+  glDeleteTextures(1, &this->id);
+  this->id = 0;
+}
@@ -0,0 +1,75 @@
+#ifndef ANIMATIONTEXTURE_H
+#define ANIMATIONTEXTURE_H
+
+#include "../../math/mat4.h"
+#include <vector>
+
+/// @brief per instance data read by shaders/vat.vert from the shader storage
+/// buffer at binding 0, laid out to match its std430 block
+struct AnimationInstance
+{
+  Mat4x4 transform;
+  // first texture row of the clip
+  float firstRow;
+  // rows baked for the clip
+  float frameCount;
+  // seconds added to the shared time, so instances playing the same clip
+  // are out of step
+  float timeOffset;
+  // rows per second
+  float rate;
+};
+
+/// @brief skinning palettes of whole clips sampled at a fixed rate and stored
+/// in a RGBA32F texture, so instanced draws animate in the vertex shader with
+/// no per frame cpu work. every row is one frame of one clip, every joint of
+/// every skin takes 3 texels holding the top 3 rows of its matrix.
+/// rigid meshes are not baked.
+class AnimationTexture
+{
+public:
+  /// @brief rows of one baked clip
+  struct ClipRange
+  {
+    int firstRow;
+    int frameCount;
+    float rate;
+    float duration;
+  };
+
+  AnimationTexture() : width(0), height(0), id(0), joints(0) {}
+  ~AnimationTexture() {}
+
+  /// @brief samples every clip of the controller at roughly rate samples per
+  /// second. the rate of each clip is adjusted so its first and last rows
+  /// land on its start and end
+  void bake(class Controller &controller, float rate);
+  /// @brief creates the texture from the baked rows and drops the cpu copy
+  /// @return false, leaving id 0, if nothing was baked or the rows don't
+  /// fit the max texture size
+  bool upload();
+  void bind(int unit);
+
+  size_t clipCount() const;
+  const ClipRange &getClip(size_t index) const;
+  /// @brief joint column where the palette of a skin starts
+  int getSkinOffset(size_t skin) const;
+  /// @brief instance data playing clip, offset seconds into it
+  AnimationInstance getInstance(const Mat4x4 &transform, size_t clip, float offset) const;
+  size_t memory() const;
+
+  void clean();
+
+  int width, height;
+  unsigned int id;
+
+private:
+  // palette entries in a row, all skins
+  int joints;
+  std::vector<int> skinOffsets;
+  std::vector<ClipRange> clips;
+  // 12 floats per joint per row until uploaded
+  std::vector<float> texels;
+};
+
+#endif
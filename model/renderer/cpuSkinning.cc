@@ -0,0 +1,231 @@
+#include "cpuSkinning.h"
+#include "mesh.h"
+#include "workerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SKINNING_SSE
+#endif
+
+// fewer vertices per thread than this cost more to hand out than to skin
+static const size_t verticesPerThread = 16384;
+
+void CpuSkinning::setMesh(const Mesh &mesh)
+{
+  this->count = mesh.vertices.size();
+  this->maxJoint = -1;
+
+  // padding vertices have no weight and skin to the origin
+  size_t padded = (this->count + batch - 1) / batch * batch;
+  for (auto *stream : {&this->px, &this->py, &this->pz, &this->nx, &this->ny, &this->nz})
+  {
+    stream->assign(padded, 0.0f);
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    this->weights[i].assign(padded, 0.0f);
+    this->joints[i].assign(padded, 0);
+  }
+
+  for (size_t v = 0; v < this->count; ++v)
+  {
+    const Vertex &vertex = mesh.vertices[v];
+    this->px[v] = vertex.pos.x;
+    this->py[v] = vertex.pos.y;
+    this->pz[v] = vertex.pos.z;
+    this->nx[v] = vertex.norm.x;
+    this->ny[v] = vertex.norm.y;
+    this->nz[v] = vertex.norm.z;
+    for (int i = 0; i < 4; ++i)
+    {
+      // unused influences are -1 with no weight, any joint will do
+      int joint = vertex.weights[i] != 0.0f ? vertex.joints[i] : 0;
+      this->weights[i][v] = vertex.weights[i];
+      this->joints[i][v] = std::max(joint, 0);
+      this->maxJoint = std::max(this->maxJoint, this->joints[i][v]);
+    }
+  }
+}
+
+bool CpuSkinning::skin(const Mat4x4 *palette, int paletteSize, std::vector<SkinnedVertex> &out,
+                       int threads)
+{
+  if (this->maxJoint >= paletteSize)
+  {
+    std::cout << "cpu skinning: palette of " << paletteSize << " joints, mesh uses joint "
+              << this->maxJoint << std::endl;
+    return false;
+  }
+  out.resize(this->count);
+
+  if (threads <= 0)
+  {
+    threads = WorkerPool::shared().size();
+  }
+  threads = (int)std::min((size_t)threads, this->count / verticesPerThread + 1);
+  // more chunks than pool threads queue up behind each other
+  this->lastThreads = std::min(threads, WorkerPool::shared().size());
+
+  // chunks start on a batch so no two threads share one
+  size_t chunk = (this->count + threads - 1) / threads;
+  chunk = (chunk + batch - 1) / batch * batch;
+
+  SkinnedVertex *vertices = out.data();
+  WorkerPool::shared().run((int)((this->count + chunk - 1) / chunk), [&](int task) {
+    size_t first = task * chunk;
+    this->skinRange(palette, first, std::min(first + chunk, this->count), vertices);
+  });
+  return true;
+}
+
+bool CpuSkinning::skinReference(const Mat4x4 *palette, int paletteSize,
+                                std::vector<SkinnedVertex> &out)
+{
+  if (this->maxJoint >= paletteSize)
+  {
+    return false;
+  }
+  out.resize(this->count);
+  for (size_t v = 0; v < this->count; ++v)
+  {
+    this->skinVertex(palette, v, out[v]);
+  }
+  return true;
+}
+
+size_t CpuSkinning::size() const { return this->count; }
+
+int CpuSkinning::getThreads() const { return this->lastThreads; }
+
+void CpuSkinning::skinRange(const Mat4x4 *palette, size_t first, size_t last,
+                            SkinnedVertex *out) const
+{
+#ifdef SKINNING_SSE
+  const __m128 zero = _mm_setzero_ps();
+  for (size_t v = first; v < last; v += batch)
+  {
+    // the 3 top rows of the blended matrix of 4 vertices, m[r * 4 + k] holds
+    // entry r, k of each vertex
+    __m128 m[12];
+    for (__m128 &entry : m)
+    {
+      entry = zero;
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+      __m128 w = _mm_loadu_ps(&this->weights[i][v]);
+      if (_mm_movemask_ps(_mm_cmpneq_ps(w, zero)) == 0)
+      {
+        continue;
+      }
+      const int *j = &this->joints[i][v];
+
+      for (int r = 0; r < 3; ++r)
+      {
+        // row r of each vertex's joint, transposed into one entry per register
+        __m128 a = _mm_loadu_ps(palette[j[0]].rc[r]);
+        __m128 b = _mm_loadu_ps(palette[j[1]].rc[r]);
+        __m128 c = _mm_loadu_ps(palette[j[2]].rc[r]);
+        __m128 d = _mm_loadu_ps(palette[j[3]].rc[r]);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        m[r * 4 + 0] = _mm_add_ps(m[r * 4 + 0], _mm_mul_ps(w, a));
+        m[r * 4 + 1] = _mm_add_ps(m[r * 4 + 1], _mm_mul_ps(w, b));
+        m[r * 4 + 2] = _mm_add_ps(m[r * 4 + 2], _mm_mul_ps(w, c));
+        m[r * 4 + 3] = _mm_add_ps(m[r * 4 + 3], _mm_mul_ps(w, d));
+      }
+    }
+
+    __m128 x = _mm_loadu_ps(&this->px[v]);
+    __m128 y = _mm_loadu_ps(&this->py[v]);
+    __m128 z = _mm_loadu_ps(&this->pz[v]);
+    __m128 normalX = _mm_loadu_ps(&this->nx[v]);
+    __m128 normalY = _mm_loadu_ps(&this->ny[v]);
+    __m128 normalZ = _mm_loadu_ps(&this->nz[v]);
+
+    __m128 result[6];
+    for (int r = 0; r < 3; ++r)
+    {
+      result[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r * 4 + 0], x), _mm_mul_ps(m[r * 4 + 1], y)),
+                             _mm_add_ps(_mm_mul_ps(m[r * 4 + 2], z), m[r * 4 + 3]));
+      result[3 + r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[r * 4 + 0], normalX),
+                                            _mm_mul_ps(m[r * 4 + 1], normalY)),
+                                 _mm_mul_ps(m[r * 4 + 2], normalZ));
+    }
+
+    // normals go through the blended matrix itself, exact for joints
+    // without non uniform scale, then get normalized
+    __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(result[3], result[3]),
+                                           _mm_mul_ps(result[4], result[4])),
+                                _mm_mul_ps(result[5], result[5]));
+    length2 = _mm_max_ps(length2, _mm_set1_ps(1e-20f));
+    __m128 estimate = _mm_rsqrt_ps(length2);
+    __m128 inverse = _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f),
+                                                     _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), length2),
+                                                                _mm_mul_ps(estimate, estimate))));
+    for (int r = 3; r < 6; ++r)
+    {
+      result[r] = _mm_mul_ps(result[r], inverse);
+    }
+
+    float lanes[6][batch];
+    for (int r = 0; r < 6; ++r)
+    {
+      _mm_storeu_ps(lanes[r], result[r]);
+    }
+    size_t end = std::min(v + batch, last);
+    for (size_t lane = 0; v + lane < end; ++lane)
+    {
+      SkinnedVertex &vertex = out[v + lane];
+      vertex.pos[0] = lanes[0][lane];
+      vertex.pos[1] = lanes[1][lane];
+      vertex.pos[2] = lanes[2][lane];
+      vertex.norm[0] = lanes[3][lane];
+      vertex.norm[1] = lanes[4][lane];
+      vertex.norm[2] = lanes[5][lane];
+    }
+  }
+#else
+  for (size_t v = first; v < last; ++v)
+  {
+    this->skinVertex(palette, v, out[v]);
+  }
+#endif
+}
+
+void CpuSkinning::skinVertex(const Mat4x4 *palette, size_t v, SkinnedVertex &out) const
+{
+  float m[3][4] = {};
+  for (int i = 0; i < 4; ++i)
+  {
+    float w = this->weights[i][v];
+    if (w == 0.0f)
+    {
+      continue;
+    }
+    const Mat4x4 &joint = palette[this->joints[i][v]];
+    for (int r = 0; r < 3; ++r)
+    {
+      for (int k = 0; k < 4; ++k)
+      {
+        m[r][k] += w * joint.rc[r][k];
+      }
+    }
+  }
+
+  float normal[3];
+  for (int r = 0; r < 3; ++r)
+  {
+    out.pos[r] = m[r][0] * this->px[v] + m[r][1] * this->py[v] + m[r][2] * this->pz[v] + m[r][3];
+    normal[r] = m[r][0] * this->nx[v] + m[r][1] * this->ny[v] + m[r][2] * this->nz[v];
+  }
+  float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+  float inverse = 1.0f / std::max(length, 1e-10f);
+  for (int r = 0; r < 3; ++r)
+  {
+    out.norm[r] = normal[r] * inverse;
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef CPUSKINNING_H
+#define CPUSKINNING_H
+
+#include "../../math/mat4.h"
+#include "skinningPass.h"
+#include <cstddef>
+#include <vector>
+
+/// @brief linear blend skinning on the cpu, for tools without a gpu,
+/// picking, tight bounds and machines where the vertex shader is the
+/// bottleneck. the vertices of one mesh are split into a stream per
+/// component, so sse skins 4 vertices per step, and large meshes are split
+/// into chunks skinned on the WorkerPool. the output matches the layout of
+/// SkinningPass, so it can be uploaded with SkinningPass::upload
+class CpuSkinning
+{
+public:
+  // vertices skinned per simd step, streams are padded to a multiple
+  static constexpr int batch = 4;
+
+  CpuSkinning() : count(0), maxJoint(-1), lastThreads(0) {}
+  ~CpuSkinning() {}
+
+  /// @brief copies the vertices of a skinned mesh into the streams
+  void setMesh(const struct Mesh &mesh);
+  /// @brief skins every vertex with the palette of the mesh's skin
+  /// @param threads 0 picks one per core, small meshes use fewer, see getThreads
+  /// @return false if the palette is too short for the mesh's joints
+  bool skin(const Mat4x4 *palette, int paletteSize, std::vector<SkinnedVertex> &out,
+            int threads = 0);
+  /// @brief one vertex at a time without simd or threads, to check skin
+  bool skinReference(const Mat4x4 *palette, int paletteSize, std::vector<SkinnedVertex> &out);
+
+  size_t size() const;
+  /// @brief threads the last skin ran on, after capping them for the mesh size
+  int getThreads() const;
+
+private:
+  size_t count;
+  int maxJoint;
+  int lastThreads;
+
+  std::vector<float> px, py, pz;
+  std::vector<float> nx, ny, nz;
+  std::vector<float> weights[4];
+  std::vector<int> joints[4];
+
+  /// @brief skins vertices first to last, first is a multiple of batch
+  void skinRange(const Mat4x4 *palette, size_t first, size_t last, SkinnedVertex *out) const;
+  void skinVertex(const Mat4x4 *palette, size_t v, SkinnedVertex &out) const;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "debugRenderer.h"
 #include "../../external/glad/glad.h"
+#include "glState.h"
 
 DebugRenderer::DebugRenderer() : VAO(0), VBO(0), EBO(0), lineShader(nullptr) {}
 
@@ -70,9 +71,8 @@ void DebugRenderer::renderBoundingBox(const BoundingBox &bbox, const Mat4x4 &tra
   lineShader->updateMat4("transform", bboxTransform);
 
   // Draw the bounding box lines
-  glBindVertexArray(VAO);
+  GLState::bindVertexArray(VAO);
   glDrawElements(GL_LINES, lineIndices.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
 }
 
 void DebugRenderer::clean()
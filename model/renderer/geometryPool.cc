@@ -0,0 +1,129 @@
+#include "geometryPool.h"
+
+#include "../../external/glad/glad.h"
+#include <algorithm>
+#include <cstddef>
+
+// elements a buffer starts with, so small models don't grow it every time
+static const size_t minimumCapacity = 1 << 16;
+
+/// @brief makes buffer hold at least needed elements, copying the used ones
+/// into a buffer of twice the capacity when it doesn't
+static void reserve(uint &buffer, size_t &capacity, size_t used, size_t needed, size_t elementSize)
+{
+  if (needed <= capacity)
+  {
+    return;
+  }
+
+  size_t grown = std::max({needed, capacity * 2, minimumCapacity});
+  uint replacement = 0;
+  glCreateBuffers(1, &replacement);
+  glNamedBufferData(replacement, grown * elementSize, nullptr, GL_STATIC_DRAW);
+  if (used > 0)
+  {
+    glCopyNamedBufferSubData(buffer, replacement, 0, 0, used * elementSize);
+  }
+  glDeleteBuffers(1, &buffer);
+  buffer = replacement;
+  capacity = grown;
+}
+
+bool GeometryPool::add(Mesh &mesh)
+{
+  if (mesh.mode != TRIANGLES || mesh.pooled)
+  {
+    return false;
+  }
+
+  if (this->VAO == 0)
+  {
+    glCreateVertexArrays(1, &this->VAO);
+    glCreateBuffers(1, &this->VBO);
+    glCreateBuffers(1, &this->EBO);
+
+    // same attributes as Mesh::init
+    glVertexArrayAttribFormat(this->VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, pos));
+    glVertexArrayAttribFormat(this->VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, norm));
+    glVertexArrayAttribFormat(this->VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tc));
+    glVertexArrayAttribFormat(this->VAO, 3, 4, GL_FLOAT, GL_FALSE, offsetof(Vertex, weights));
+    glVertexArrayAttribIFormat(this->VAO, 4, 4, GL_INT, offsetof(Vertex, joints));
+    for (uint attrib = 0; attrib < 5; ++attrib)
+    {
+      glVertexArrayAttribBinding(this->VAO, attrib, 0);
+      glEnableVertexArrayAttrib(this->VAO, attrib);
+    }
+  }
+
+  if (mesh.indices.empty())
+  {
+    for (uint i = 0; i < mesh.vertices.size(); ++i)
+    {
+      mesh.indices.push_back(i);
+    }
+  }
+
+  mesh.baseVertex = (int)(this->vertexTotal + this->vertices.size());
+  mesh.firstIndex = (uint)(this->indexTotal + this->indices.size());
+  this->vertices.insert(this->vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+  this->indices.insert(this->indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+  // the mesh draws from the pool from now on
+  glDeleteVertexArrays(1, &mesh.VAO);
+  glDeleteBuffers(1, &mesh.VBO);
+  glDeleteBuffers(1, &mesh.EBO);
+  mesh.VAO = this->VAO;
+  mesh.VBO = 0;
+  mesh.EBO = 0;
+  mesh.pooled = true;
+
+  return true;
+}
+
+void GeometryPool::upload()
+{
+  if (this->VAO == 0)
+  {
+    return;
+  }
+
+  reserve(this->VBO, this->vertexCapacity, this->vertexTotal, this->vertexTotal + this->vertices.size(),
+          sizeof(Vertex));
+  reserve(this->EBO, this->indexCapacity, this->indexTotal, this->indexTotal + this->indices.size(),
+          sizeof(uint));
+
+  // only the new ranges go up, the cpu copies aren't needed afterwards
+  glNamedBufferSubData(this->VBO, this->vertexTotal * sizeof(Vertex), this->vertices.size() * sizeof(Vertex),
+                       this->vertices.data());
+  glNamedBufferSubData(this->EBO, this->indexTotal * sizeof(uint), this->indices.size() * sizeof(uint),
+                       this->indices.data());
+  this->vertexTotal += this->vertices.size();
+  this->indexTotal += this->indices.size();
+  this->vertices.clear();
+  this->vertices.shrink_to_fit();
+  this->indices.clear();
+  this->indices.shrink_to_fit();
+
+  glVertexArrayVertexBuffer(this->VAO, 0, this->VBO, 0, sizeof(Vertex));
+  glVertexArrayElementBuffer(this->VAO, this->EBO);
+}
+
+size_t GeometryPool::vertexCount() { return this->vertexTotal + this->vertices.size(); }
+
+size_t GeometryPool::indexCount() { return this->indexTotal + this->indices.size(); }
+
+void GeometryPool::clean()
+{
+  glDeleteVertexArrays(1, &this->VAO);
+  glDeleteBuffers(1, &this->VBO);
+  glDeleteBuffers(1, &this->EBO);
+  this->VAO = 0;
+  this->VBO = 0;
+  this->EBO = 0;
+  this->vertices.clear();
+  this->indices.clear();
+  this->vertexTotal = 0;
+  this->indexTotal = 0;
+  this->vertexCapacity = 0;
+  this->indexCapacity = 0;
+}
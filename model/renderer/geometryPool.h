@@ -0,0 +1,60 @@
+#ifndef GEOMETRYPOOL_H
+#define GEOMETRYPOOL_H
+
+#include <vector>
+#include "mesh.h"
+
+/// @brief layout of one draw in a GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+  unsigned int count;
+  unsigned int instanceCount;
+  unsigned int firstIndex;
+  int baseVertex;
+  unsigned int baseInstance;
+};
+
+/// @brief vertices and indices of many meshes suballocated from one vertex
+/// buffer and one index buffer, all read through a single VAO. pooled meshes
+/// drop their own buffers and draw at their offsets into the pool, so any
+/// number of them can go out in one multi draw. the buffers grow by
+/// doubling, so adding models only uploads the new meshes
+class GeometryPool
+{
+public:
+  GeometryPool()
+      : VAO(0), VBO(0), EBO(0), vertexTotal(0), indexTotal(0), vertexCapacity(0), indexCapacity(0)
+  {
+  }
+  ~GeometryPool() {}
+
+  /// @brief moves the mesh into the pool. only triangle meshes are pooled,
+  /// meshes without indices get a trivial index list
+  /// @return true if the mesh was pooled
+  bool add(Mesh &mesh);
+  /// @brief appends the meshes added since the last upload to the shared
+  /// buffers, pooled meshes can not be drawn before. growing a buffer
+  /// replaces it, so VBO and EBO may change
+  void upload();
+
+  size_t vertexCount();
+  size_t indexCount();
+
+  void clean();
+
+  uint VAO;
+  uint VBO;
+  uint EBO;
+
+private:
+  // vertices and indices added since the last upload
+  std::vector<Vertex> vertices;
+  std::vector<uint> indices;
+  // uploaded and pending counts, and the counts the buffers can hold
+  size_t vertexTotal;
+  size_t indexTotal;
+  size_t vertexCapacity;
+  size_t indexCapacity;
+};
+
+#endif
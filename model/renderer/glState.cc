@@ -0,0 +1,235 @@
+#include "glState.h"
+
+// marks shadowed state as unknown, no gl object is ever named this
+static const GLuint unknown = ~0u;
+
+static const int maxTextureUnits = 32;
+static const int maxBufferBindings = 16;
+static const int maxCapabilities = 3;
+
+static const GLenum capabilities[maxCapabilities] = {GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND};
+
+struct ShadowState
+{
+  GLuint program;
+  GLuint vao;
+  GLuint textures[maxTextureUnits];
+  GLuint arrayBuffer;
+  GLuint indirectBuffer;
+  GLuint storageBuffers[maxBufferBindings];
+  GLuint uniformBuffers[maxBufferBindings];
+  // 0 disabled, 1 enabled, unknown
+  GLuint enabled[maxCapabilities];
+  GLenum blendSource;
+  GLenum blendDestination;
+  GLenum depthFunc;
+  GLuint depthMask;
+  GLuint colorMask;
+
+  GLStateStats stats;
+
+  ShadowState() { this->forget(); }
+
+  void forget()
+  {
+    this->program = unknown;
+    this->vao = unknown;
+    for (GLuint &texture : this->textures)
+    {
+      texture = unknown;
+    }
+    this->arrayBuffer = unknown;
+    this->indirectBuffer = unknown;
+    for (int i = 0; i < maxBufferBindings; ++i)
+    {
+      this->storageBuffers[i] = unknown;
+      this->uniformBuffers[i] = unknown;
+    }
+    for (GLuint &capability : this->enabled)
+    {
+      capability = unknown;
+    }
+    this->blendSource = unknown;
+    this->blendDestination = unknown;
+    this->depthFunc = unknown;
+    this->depthMask = unknown;
+    this->colorMask = unknown;
+  }
+};
+
+static ShadowState shadow;
+
+/// @brief updates a shadowed value
+/// @return true if the call has to be issued
+static bool change(GLuint &shadowed, GLuint value)
+{
+  if (shadowed == value)
+  {
+    shadow.stats.elided++;
+    return false;
+  }
+  shadowed = value;
+  shadow.stats.issued++;
+  return true;
+}
+
+void GLState::beginFrame()
+{
+  shadow.stats = GLStateStats();
+  invalidate();
+}
+
+void GLState::invalidate() { shadow.forget(); }
+
+void GLState::useProgram(GLuint program)
+{
+  if (change(shadow.program, program))
+  {
+    glUseProgram(program);
+  }
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+  if (change(shadow.vao, vao))
+  {
+    glBindVertexArray(vao);
+  }
+}
+
+void GLState::bindTexture(GLuint unit, GLuint texture)
+{
+  if (unit >= (GLuint)maxTextureUnits)
+  {
+    shadow.stats.issued++;
+    glBindTextureUnit(unit, texture);
+    return;
+  }
+  if (change(shadow.textures[unit], texture))
+  {
+    glBindTextureUnit(unit, texture);
+  }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+  GLuint *shadowed = nullptr;
+  switch (target)
+  {
+  case GL_ARRAY_BUFFER:
+    shadowed = &shadow.arrayBuffer;
+    break;
+  case GL_DRAW_INDIRECT_BUFFER:
+    shadowed = &shadow.indirectBuffer;
+    break;
+  default:
+    // the element buffer belongs to the bound vao, not the context
+    break;
+  }
+
+  if (shadowed == nullptr)
+  {
+    shadow.stats.issued++;
+    glBindBuffer(target, buffer);
+  }
+  else if (change(*shadowed, buffer))
+  {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GLState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+  GLuint *shadowed = nullptr;
+  if (index < (GLuint)maxBufferBindings)
+  {
+    if (target == GL_SHADER_STORAGE_BUFFER)
+    {
+      shadowed = &shadow.storageBuffers[index];
+    }
+    else if (target == GL_UNIFORM_BUFFER)
+    {
+      shadowed = &shadow.uniformBuffers[index];
+    }
+  }
+
+  if (shadowed == nullptr)
+  {
+    shadow.stats.issued++;
+    glBindBufferBase(target, index, buffer);
+  }
+  else if (change(*shadowed, buffer))
+  {
+    glBindBufferBase(target, index, buffer);
+  }
+}
+
+void GLState::setEnabled(GLenum capability, bool enabled)
+{
+  int index = -1;
+  for (int i = 0; i < maxCapabilities; ++i)
+  {
+    if (capabilities[i] == capability)
+    {
+      index = i;
+    }
+  }
+
+  if (index == -1)
+  {
+    shadow.stats.issued++;
+  }
+  else if (!change(shadow.enabled[index], enabled ? 1 : 0))
+  {
+    return;
+  }
+
+  if (enabled)
+  {
+    glEnable(capability);
+  }
+  else
+  {
+    glDisable(capability);
+  }
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+  if (shadow.blendSource == source && shadow.blendDestination == destination)
+  {
+    shadow.stats.elided++;
+    return;
+  }
+  shadow.blendSource = source;
+  shadow.blendDestination = destination;
+  shadow.stats.issued++;
+  glBlendFunc(source, destination);
+}
+
+void GLState::depthFunc(GLenum func)
+{
+  if (change(shadow.depthFunc, func))
+  {
+    glDepthFunc(func);
+  }
+}
+
+void GLState::depthMask(bool write)
+{
+  if (change(shadow.depthMask, write ? 1 : 0))
+  {
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+  }
+}
+
+void GLState::colorMask(bool write)
+{
+  if (change(shadow.colorMask, write ? 1 : 0))
+  {
+    GLboolean mask = write ? GL_TRUE : GL_FALSE;
+    glColorMask(mask, mask, mask, mask);
+  }
+}
+
+const GLStateStats &GLState::getStats() { return shadow.stats; }
@@ -0,0 +1,47 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include "../../external/glad/glad.h"
+#include <cstddef>
+
+/// @brief gl calls made through GLState since the last beginFrame
+struct GLStateStats
+{
+  // calls passed on to the driver
+  size_t issued{0};
+  // calls dropped because the state was already set
+  size_t elided{0};
+};
+
+/// @brief shadow of the binding and fixed function state of the context.
+/// draw code changes state through here so binding what is already bound
+/// costs a compare instead of a driver call. code that binds through gl
+/// directly (loading, imgui) leaves the shadow stale, so every frame starts
+/// from an unknown state and the first change of each kind is issued
+class GLState
+{
+public:
+  /// @brief forgets the shadowed state and resets the counters
+  static void beginFrame();
+  /// @brief forgets the shadowed state after gl was called directly
+  static void invalidate();
+
+  static void useProgram(GLuint program);
+  static void bindVertexArray(GLuint vao);
+  /// @brief binds texture to unit on its own target, see glBindTextureUnit
+  static void bindTexture(GLuint unit, GLuint texture);
+  static void bindBuffer(GLenum target, GLuint buffer);
+  /// @brief binds buffer to an indexed storage or uniform buffer binding
+  static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+  static void setEnabled(GLenum capability, bool enabled);
+  static void blendFunc(GLenum source, GLenum destination);
+  static void depthFunc(GLenum func);
+  static void depthMask(bool write);
+  /// @brief writes to all color channels or to none
+  static void colorMask(bool write);
+
+  static const GLStateStats &getStats();
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "lightClusters.h"
+#include "shader.h"
+#include "glState.h"
+#include "workerPool.h"
+#include "../../math/utils.h"
+
+#include "../../external/glad/glad.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CLUSTERS_SSE
+#endif
+
+static const int tileCount = LightClusters::tilesX * LightClusters::tilesY;
+
+// below this many lights a single thread is faster than handing out slices
+static const size_t threadedLights = 64;
+
+LightClusters::LightClusters()
+    : fov(0.0f), ratio(0.0f), zNear(0.0f), zFar(0.0f), lightBuffer(0), rangeBuffer(0),
+      indexBuffer(0)
+{
+  this->counts.resize(clusterCount);
+  this->slots.resize((size_t)clusterCount * maxClusterLights);
+  this->droppedPerSlice.resize(slices);
+  this->ranges.resize((size_t)clusterCount * 2);
+}
+
+void LightClusters::update(const std::vector<PointLight> &lights, const Mat4x4 &view, float fov,
+                           float ratio, float zNear, float zFar)
+{
+  if (fov != this->fov || ratio != this->ratio || zNear != this->zNear || zFar != this->zFar)
+  {
+    this->buildBounds(fov, ratio, zNear, zFar);
+  }
+
+  this->viewLights.resize(lights.size());
+  for (size_t i = 0; i < lights.size(); ++i)
+  {
+    const PointLight &light = lights[i];
+    ViewLight &viewLight = this->viewLights[i];
+    const float *p = light.position;
+    viewLight.x = view.rc[0][0] * p[0] + view.rc[0][1] * p[1] + view.rc[0][2] * p[2] + view.rc[0][3];
+    viewLight.y = view.rc[1][0] * p[0] + view.rc[1][1] * p[1] + view.rc[1][2] * p[2] + view.rc[1][3];
+    // the camera looks down -z
+    viewLight.depth = -(view.rc[2][0] * p[0] + view.rc[2][1] * p[1] + view.rc[2][2] * p[2] +
+                        view.rc[2][3]);
+    viewLight.radius = light.radius;
+  }
+
+  // slices don't share clusters, so each thread takes a run of them
+  int threads = 1;
+  if (this->viewLights.size() >= threadedLights)
+  {
+    threads = std::min(WorkerPool::shared().size(), slices);
+  }
+  int perThread = (slices + threads - 1) / threads;
+
+  WorkerPool::shared().run((slices + perThread - 1) / perThread, [&](int task) {
+    int first = task * perThread;
+    this->assignSlices(first, std::min(first + perThread, slices));
+  });
+
+  // pack the used slots so only real references are uploaded
+  this->stats = LightClusterStats();
+  this->stats.lights = lights.size();
+  this->packed.clear();
+  for (int c = 0; c < clusterCount; ++c)
+  {
+    uint32_t count = this->counts[c];
+    this->ranges[c * 2] = (uint32_t)this->packed.size();
+    this->ranges[c * 2 + 1] = count;
+    const uint32_t *slot = &this->slots[(size_t)c * maxClusterLights];
+    this->packed.insert(this->packed.end(), slot, slot + count);
+    this->stats.busiestCluster = std::max(this->stats.busiestCluster, (size_t)count);
+  }
+  this->stats.references = this->packed.size();
+  for (uint32_t dropped : this->droppedPerSlice)
+  {
+    this->stats.dropped += dropped;
+  }
+
+  if (this->lightBuffer == 0)
+  {
+    glCreateBuffers(1, &this->lightBuffer);
+    glCreateBuffers(1, &this->rangeBuffer);
+    glCreateBuffers(1, &this->indexBuffer);
+  }
+  // storage buffers can't be empty, keep one element around
+  PointLight none{};
+  glNamedBufferData(this->lightBuffer, std::max<size_t>(lights.size(), 1) * sizeof(PointLight),
+                    lights.empty() ? &none : lights.data(), GL_STREAM_DRAW);
+  glNamedBufferData(this->rangeBuffer, this->ranges.size() * sizeof(uint32_t),
+                    this->ranges.data(), GL_STREAM_DRAW);
+  uint32_t noIndex = 0;
+  glNamedBufferData(this->indexBuffer, std::max<size_t>(this->packed.size(), 1) * sizeof(uint32_t),
+                    this->packed.empty() ? &noIndex : this->packed.data(), GL_STREAM_DRAW);
+}
+
+void LightClusters::bind(unsigned int firstBinding)
+{
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, firstBinding, this->lightBuffer);
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, firstBinding + 1, this->rangeBuffer);
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, firstBinding + 2, this->indexBuffer);
+}
+
+void LightClusters::configShader(Shader &shader) const
+{
+  // slice = log(depth) * scale + bias, the inverse of the spacing in
+  // buildBounds
+  float scale = (float)slices / logf(this->zFar / this->zNear);
+  float bias = -scale * logf(this->zNear);
+
+  shader.updateInt("clusterTilesX", tilesX);
+  shader.updateInt("clusterTilesY", tilesY);
+  shader.updateInt("clusterSlices", slices);
+  shader.updateFloat("clusterScale", scale);
+  shader.updateFloat("clusterBias", bias);
+}
+
+const LightClusterStats &LightClusters::getStats() const { return this->stats; }
+
+void LightClusters::clean()
+{
+  glDeleteBuffers(1, &this->lightBuffer);
+  glDeleteBuffers(1, &this->rangeBuffer);
+  glDeleteBuffers(1, &this->indexBuffer);
+  this->lightBuffer = 0;
+  this->rangeBuffer = 0;
+  this->indexBuffer = 0;
+}
+
+void LightClusters::buildBounds(float fov, float ratio, float zNear, float zFar)
+{
+  this->fov = fov;
+  this->ratio = ratio;
+  this->zNear = zNear;
+  this->zFar = zFar;
+
+  float tanY = tanf(to_radians(fov / 2.0f));
+  float tanX = tanY * ratio;
+
+  this->bounds.resize(slices);
+  for (int s = 0; s < slices; ++s)
+  {
+    SliceBounds &slice = this->bounds[s];
+    slice.nearDepth = zNear * powf(zFar / zNear, (float)s / (float)slices);
+    slice.farDepth = zNear * powf(zFar / zNear, (float)(s + 1) / (float)slices);
+
+    for (int y = 0; y < tilesY; ++y)
+    {
+      for (int x = 0; x < tilesX; ++x)
+      {
+        // tile edges in ndc, scaled out to the near and far depth of the
+        // slice. the box around both is conservative
+        float left = -1.0f + 2.0f * (float)x / (float)tilesX;
+        float right = -1.0f + 2.0f * (float)(x + 1) / (float)tilesX;
+        float bottom = -1.0f + 2.0f * (float)y / (float)tilesY;
+        float top = -1.0f + 2.0f * (float)(y + 1) / (float)tilesY;
+
+        int tile = y * tilesX + x;
+        slice.minX[tile] = std::min(left * slice.nearDepth, left * slice.farDepth) * tanX;
+        slice.maxX[tile] = std::max(right * slice.nearDepth, right * slice.farDepth) * tanX;
+        slice.minY[tile] = std::min(bottom * slice.nearDepth, bottom * slice.farDepth) * tanY;
+        slice.maxY[tile] = std::max(top * slice.nearDepth, top * slice.farDepth) * tanY;
+      }
+    }
+  }
+}
+
+void LightClusters::assignSlices(int first, int last)
+{
+  for (int s = first; s < last; ++s)
+  {
+    const SliceBounds &slice = this->bounds[s];
+    uint32_t *counts = &this->counts[(size_t)s * tileCount];
+    uint32_t *slots = &this->slots[(size_t)s * tileCount * maxClusterLights];
+    uint32_t dropped = 0;
+    std::fill(counts, counts + tileCount, 0u);
+
+    for (size_t l = 0; l < this->viewLights.size(); ++l)
+    {
+      const ViewLight &light = this->viewLights[l];
+
+      // distance to the slice along depth, what is left of the radius
+      // limits the distance across the tiles
+      float dz = std::max({slice.nearDepth - light.depth, light.depth - slice.farDepth, 0.0f});
+      float limit = light.radius * light.radius - dz * dz;
+      if (limit < 0.0f)
+      {
+        continue;
+      }
+
+      for (int t = 0; t < tileCount; t += 4)
+      {
+        int mask = 0;
+#ifdef CLUSTERS_SSE
+        __m128 zero = _mm_setzero_ps();
+        __m128 px = _mm_set1_ps(light.x);
+        __m128 py = _mm_set1_ps(light.y);
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(slice.minX + t), px),
+                                          _mm_sub_ps(px, _mm_loadu_ps(slice.maxX + t))),
+                               zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(slice.minY + t), py),
+                                          _mm_sub_ps(py, _mm_loadu_ps(slice.maxY + t))),
+                               zero);
+        __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        mask = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(limit)));
+#else
+        for (int i = 0; i < 4; ++i)
+        {
+          float dx = std::max({slice.minX[t + i] - light.x, light.x - slice.maxX[t + i], 0.0f});
+          float dy = std::max({slice.minY[t + i] - light.y, light.y - slice.maxY[t + i], 0.0f});
+          if (dx * dx + dy * dy <= limit)
+          {
+            mask |= 1 << i;
+          }
+        }
+#endif
+        for (int i = 0; mask != 0; ++i, mask >>= 1)
+        {
+          if ((mask & 1) == 0)
+          {
+            continue;
+          }
+          uint32_t &count = counts[t + i];
+          if (count == maxClusterLights)
+          {
+            dropped++;
+            continue;
+          }
+          slots[(size_t)(t + i) * maxClusterLights + count] = (uint32_t)l;
+          count++;
+        }
+      }
+    }
+    this->droppedPerSlice[s] = dropped;
+  }
+}
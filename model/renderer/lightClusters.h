@@ -0,0 +1,108 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include "../../math/mat4.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief point light as the pbr shader reads it, std430 layout
+struct PointLight
+{
+  float position[3];
+  // the light is faded out to nothing at this distance
+  float radius;
+  float color[3];
+  float padding;
+};
+
+/// @brief light assignment of the last update
+struct LightClusterStats
+{
+  size_t lights{0};
+  // light indices written over all clusters
+  size_t references{0};
+  size_t busiestCluster{0};
+  // lights left out of full clusters
+  size_t dropped{0};
+};
+
+/// @brief clustered forward shading. the view frustum is cut into
+/// tilesX * tilesY screen tiles and slices depth slices, spaced
+/// exponentially. every frame the lights are assigned on the cpu to the
+/// clusters their sphere touches, and the pbr shader only shades the lights
+/// of the fragment's cluster. slices are split between the threads of the
+/// WorkerPool, and each light is tested against 4 tiles at a time with sse
+class LightClusters
+{
+public:
+  static constexpr int tilesX = 16;
+  static constexpr int tilesY = 9;
+  static constexpr int slices = 24;
+  static constexpr int clusterCount = tilesX * tilesY * slices;
+  // lights a cluster can hold, also the light loop bound of the shader
+  static constexpr int maxClusterLights = 128;
+
+  LightClusters();
+  ~LightClusters() {}
+
+  /// @brief assigns the lights to the clusters of the camera and uploads
+  /// the lights and cluster lists
+  /// @param fov vertical field of view in degrees
+  void update(const std::vector<PointLight> &lights, const Mat4x4 &view, float fov, float ratio,
+              float zNear, float zFar);
+  /// @brief binds the lights, the cluster ranges and the packed cluster
+  /// light indices to consecutive storage buffer bindings
+  void bind(unsigned int firstBinding);
+  /// @brief sets the grid and slicing uniforms of a pbr shader
+  void configShader(class Shader &shader) const;
+
+  const LightClusterStats &getStats() const;
+  void clean();
+
+private:
+  // view space bounds of the tiles of one slice, one array per axis so sse
+  // can load 4 tiles at once. depth is positive away from the camera
+  struct SliceBounds
+  {
+    float minX[tilesX * tilesY];
+    float maxX[tilesX * tilesY];
+    float minY[tilesX * tilesY];
+    float maxY[tilesX * tilesY];
+    float nearDepth;
+    float farDepth;
+  };
+
+  // view space position and radius of a light
+  struct ViewLight
+  {
+    float x, y, depth, radius;
+  };
+
+  std::vector<SliceBounds> bounds;
+  float fov, ratio, zNear, zFar;
+
+  std::vector<ViewLight> viewLights;
+  // lights of each cluster, maxClusterLights slots per cluster so threads
+  // never write to the same memory
+  std::vector<uint32_t> counts;
+  std::vector<uint32_t> slots;
+  // dropped lights per slice, summed after the threads join
+  std::vector<uint32_t> droppedPerSlice;
+  // what the shader reads, offset and count of each cluster into the
+  // packed light indices
+  std::vector<uint32_t> ranges;
+  std::vector<uint32_t> packed;
+
+  unsigned int lightBuffer;
+  unsigned int rangeBuffer;
+  unsigned int indexBuffer;
+
+  LightClusterStats stats;
+
+  void buildBounds(float fov, float ratio, float zNear, float zFar);
+  /// @brief fills the clusters of slices first to last - 1
+  void assignSlices(int first, int last);
+};
+
+#endif
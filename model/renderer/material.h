@@ -13,8 +13,15 @@ struct Material
   Color3f baseCol{1.0};
   int baseTex{-1};
   int metallicMap{-1};
+  // index of the material's factors in the MaterialBuffer, 0 holds the
+  // defaults until the material is added
+  int slot{0};
+  // MaterialFlags of the slot, shader variants are picked by them
+  int flags{0};
 
-  void configShader(class Shader &);
+  /// @brief selects the material's factors, they live in the material
+  /// buffer so this is a single int uniform
+  void configShader(class Shader &) const;
 };
 
-#endif
\ No newline at end of file
+#endif
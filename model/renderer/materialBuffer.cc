@@ -0,0 +1,64 @@
+#include "materialBuffer.h"
+#include "glState.h"
+#include <cstring>
+
+MaterialBuffer::MaterialBuffer() : buffer(0)
+{
+  Material defaults;
+  this->add(defaults);
+}
+
+void MaterialBuffer::add(Material &material, int baseTexture, int metallicTexture)
+{
+  MaterialData data;
+  data.baseColor[0] = material.baseCol.x;
+  data.baseColor[1] = material.baseCol.y;
+  data.baseColor[2] = material.baseCol.z;
+  data.baseColor[3] = 1.0f;
+  data.metallic = material.metallicness;
+  data.roughness = material.roughness;
+  data.ao = material.ao;
+  data.flags = (baseTexture != -1 ? MATERIAL_BASE_TEXTURE : 0) |
+               (metallicTexture != -1 ? MATERIAL_METALLIC_MAP : 0);
+  data.baseTexture = baseTexture;
+  data.metallicTexture = metallicTexture;
+  data.padding[0] = 0;
+  data.padding[1] = 0;
+
+  for (size_t i = 0; i < this->materials.size(); ++i)
+  {
+    if (memcmp(&this->materials[i], &data, sizeof(MaterialData)) == 0)
+    {
+      material.slot = (int)i;
+      material.flags = data.flags;
+      return;
+    }
+  }
+
+  material.slot = (int)this->materials.size();
+  material.flags = data.flags;
+  this->materials.push_back(data);
+}
+
+void MaterialBuffer::upload()
+{
+  if (this->buffer == 0)
+  {
+    glCreateBuffers(1, &this->buffer);
+  }
+  glNamedBufferData(this->buffer, this->materials.size() * sizeof(MaterialData),
+                    this->materials.data(), GL_STATIC_DRAW);
+}
+
+void MaterialBuffer::bind(unsigned int binding)
+{
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->buffer);
+}
+
+size_t MaterialBuffer::size() { return this->materials.size(); }
+
+void MaterialBuffer::clean()
+{
+  glDeleteBuffers(1, &this->buffer);
+  this->buffer = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef MATERIALBUFFER_H
+#define MATERIALBUFFER_H
+
+#include <vector>
+#include "material.h"
+
+enum MaterialFlags
+{
+  MATERIAL_BASE_TEXTURE = 1,
+  MATERIAL_METALLIC_MAP = 2
+};
+
+/// @brief factors of one material, laid out to match the std430 block read
+/// by pbr.frag
+struct MaterialData
+{
+  float baseColor[4];
+  float metallic;
+  float roughness;
+  float ao;
+  // MaterialFlags
+  int flags;
+  // TextureArrays references of the base color and metallic textures
+  int baseTexture;
+  int metallicTexture;
+  int padding[2];
+};
+
+/// @brief factors of every loaded material packed into one shader storage
+/// buffer. draws select theirs with an index, so switching materials costs
+/// one int instead of a uniform per factor. slot 0 holds the defaults of
+/// Material
+class MaterialBuffer
+{
+public:
+  MaterialBuffer();
+  ~MaterialBuffer() {}
+
+  /// @brief stores the material's factors and sets its slot, materials with
+  /// equal factors and textures share a slot
+  /// @param baseTexture TextureArrays reference of the base color texture
+  /// @param metallicTexture TextureArrays reference of the metallic texture
+  void add(Material &material, int baseTexture = -1, int metallicTexture = -1);
+  /// @brief (re)creates the buffer from every material added so far
+  void upload();
+  void bind(unsigned int binding);
+
+  size_t size();
+  void clean();
+
+  unsigned int buffer;
+
+private:
+  std::vector<MaterialData> materials;
+};
+
+#endif
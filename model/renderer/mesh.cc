@@ -1,11 +1,13 @@
 #include "mesh.h"
 #include "shader.h"
 #include "boundingVolumes.h"
+#include "glState.h"
 
 #include "../../external/glad/glad.h"
 
 void Mesh::init()
 {
+  this->countInfluences();
 
   glCreateVertexArrays(1, &VAO);
 
@@ -48,48 +50,69 @@ void Mesh::init()
 
   glBindVertexArray(0);
 }
+void Mesh::countInfluences()
+{
+  this->influences = 1;
+  for (const Vertex &vertex : this->vertices)
+  {
+    for (int i = 3; i >= this->influences; --i)
+    {
+      if (vertex.weights[i] != 0.0f)
+      {
+        this->influences = i + 1;
+        break;
+      }
+    }
+  }
+}
 void Mesh::render(Shader &shader)
 {
 
   this->material.configShader(shader);
+  this->draw();
+}
+void Mesh::draw() { this->draw(VAO); }
 
+void Mesh::draw(uint vao)
+{
   switch (mode)
   {
   case POINTS:
 
-    glBindVertexArray(VAO);
+    GLState::bindVertexArray(vao);
     glDrawArrays(GL_POINTS, 0, vertices.size());
-    glBindVertexArray(0);
     break;
   case LINES:
 
     if (indices.size() != 0)
     {
-      glBindVertexArray(VAO);
+      GLState::bindVertexArray(vao);
       glDrawElements(GL_LINES, indices.size(), GL_UNSIGNED_INT, 0);
-      glBindVertexArray(0);
     }
     else
     {
-      glBindVertexArray(VAO);
+      GLState::bindVertexArray(vao);
       glDrawArrays(GL_LINES, 0, vertices.size());
-      glBindVertexArray(0);
     }
 
     break;
   case TRIANGLES:
 
-    if (indices.size() != 0)
+    if (pooled)
+    {
+      GLState::bindVertexArray(vao);
+      glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT,
+                               (void *)(firstIndex * sizeof(uint)), baseVertex);
+    }
+    else if (indices.size() != 0)
     {
-      glBindVertexArray(VAO);
+      GLState::bindVertexArray(vao);
       glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-      glBindVertexArray(0);
     }
     else
     {
-      glBindVertexArray(VAO);
+      GLState::bindVertexArray(vao);
       glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-      glBindVertexArray(0);
     }
     break;
   default:
@@ -97,6 +120,31 @@ void Mesh::render(Shader &shader)
   }
 }
 
+void Mesh::renderInstanced(Shader &shader, int count)
+{
+  if (mode != TRIANGLES || count <= 0)
+  {
+    return;
+  }
+
+  this->material.configShader(shader);
+
+  GLState::bindVertexArray(VAO);
+  if (pooled)
+  {
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT,
+                                      (void *)(firstIndex * sizeof(uint)), count, baseVertex);
+  }
+  else if (indices.size() != 0)
+  {
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, count);
+  }
+  else
+  {
+    glDrawArraysInstanced(GL_TRIANGLES, 0, vertices.size(), count);
+  }
+}
+
 BoundingBox Mesh::getBoundingBox()
 {
   BoundingBox bbox;
@@ -111,6 +159,11 @@ BoundingBox Mesh::getBoundingBox()
 
 void Mesh::clean()
 {
+  // the pool owns the buffers of pooled meshes
+  if (pooled)
+  {
+    return;
+  }
   glDeleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
   glDeleteBuffers(1, &EBO);
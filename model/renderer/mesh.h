@@ -37,9 +37,31 @@ struct Mesh
   std::vector<uint> indices;
   DrawMode mode{POINTS};
   Material material{};
+  // skin of the owning skeleton whose palette the joint indices address,
+  // -1 for rigid meshes
+  int skin{-1};
+  // skeleton joint a rigid mesh moves with, -1 for skinned meshes
+  int node{-1};
+  // set once the mesh lives in a GeometryPool, VAO is then the pool's and
+  // the mesh draws from firstIndex/baseVertex
+  bool pooled{false};
+  uint firstIndex{0};
+  int baseVertex{0};
+  // joint weights used per vertex, skinned shader variants only read these
+  int influences{4};
 
   void init();
+  /// @brief sets influences from the vertex weights, init does it too
+  void countInfluences();
   void render(class Shader &);
+  /// @brief draws with whatever material state is already set
+  void draw();
+  /// @brief draws from another VAO numbering its vertices like the mesh's,
+  /// like the output of a SkinningPass
+  void draw(uint vao);
+  /// @brief draws count copies in one call, the shader tells them apart by
+  /// gl_InstanceID
+  void renderInstanced(class Shader &, int count);
   void clean();
 
   // get bounding box
@@ -0,0 +1,404 @@
+#include "occlusionCuller.h"
+#include "mesh.h"
+#include "workerPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OCCLUSION_SSE
+#endif
+
+// below this many triangles a single thread is faster than handing out rows
+static const size_t threadedTriangles = 1024;
+// fewest rows a thread rasterizes
+static const int rowsPerThread = 16;
+
+static_assert(OcclusionCuller::width % 4 == 0, "rows are rasterized 4 pixels at a time");
+static_assert((OcclusionCuller::width >> (OcclusionCuller::levels - 1)) >= 1 &&
+                  (OcclusionCuller::height >> (OcclusionCuller::levels - 1)) >= 1,
+              "the top of the pyramid needs a texel");
+
+static Vector4f toClip(const Mat4x4 &m, float x, float y, float z)
+{
+  return Vector4f(m.rc[0][0] * x + m.rc[0][1] * y + m.rc[0][2] * z + m.rc[0][3],
+                  m.rc[1][0] * x + m.rc[1][1] * y + m.rc[1][2] * z + m.rc[1][3],
+                  m.rc[2][0] * x + m.rc[2][1] * y + m.rc[2][2] * z + m.rc[2][3],
+                  m.rc[3][0] * x + m.rc[3][1] * y + m.rc[3][2] * z + m.rc[3][3]);
+}
+
+OcclusionCuller::OcclusionCuller()
+{
+  for (int level = 0; level < levels; ++level)
+  {
+    this->pyramid[level].assign((size_t)(width >> level) * (height >> level), 1.0f);
+  }
+}
+
+void OcclusionCuller::begin(const Mat4x4 &viewProjection)
+{
+  this->viewProjection = viewProjection;
+  this->triangles.clear();
+  this->stats = OcclusionStats();
+  std::fill(this->pyramid[0].begin(), this->pyramid[0].end(), 1.0f);
+}
+
+void OcclusionCuller::addOccluder(const std::vector<SkinnedVertex> &vertices,
+                                  const std::vector<unsigned int> &indices, const Mat4x4 &transform)
+{
+  Mat4x4 m = this->viewProjection * transform;
+  this->clipVertices.resize(vertices.size());
+  for (size_t v = 0; v < vertices.size(); ++v)
+  {
+    const float *p = vertices[v].pos;
+    this->clipVertices[v] = toClip(m, p[0], p[1], p[2]);
+  }
+
+  // mirroring transforms turn front faces clockwise
+  float determinant =
+      transform.rc[0][0] * (transform.rc[1][1] * transform.rc[2][2] - transform.rc[1][2] * transform.rc[2][1]) -
+      transform.rc[0][1] * (transform.rc[1][0] * transform.rc[2][2] - transform.rc[1][2] * transform.rc[2][0]) +
+      transform.rc[0][2] * (transform.rc[1][0] * transform.rc[2][1] - transform.rc[1][1] * transform.rc[2][0]);
+  bool mirrored = determinant < 0.0f;
+
+  this->stats.occluders++;
+  for (size_t i = 0; i + 2 < indices.size(); i += 3)
+  {
+    const Vector4f *corners[3] = {&this->clipVertices[indices[i]],
+                                  &this->clipVertices[indices[i + (mirrored ? 2 : 1)]],
+                                  &this->clipVertices[indices[i + (mirrored ? 1 : 2)]]};
+
+    // clipping could only add depth in front of the camera, dropping the
+    // triangle hides less instead
+    if (corners[0]->z < -corners[0]->w || corners[1]->z < -corners[1]->w ||
+        corners[2]->z < -corners[2]->w)
+    {
+      continue;
+    }
+
+    ScreenTriangle triangle;
+    for (int k = 0; k < 3; ++k)
+    {
+      float inverseW = 1.0f / corners[k]->w;
+      triangle.x[k] = (corners[k]->x * inverseW * 0.5f + 0.5f) * (float)width;
+      triangle.y[k] = (corners[k]->y * inverseW * 0.5f + 0.5f) * (float)height;
+      triangle.z[k] = corners[k]->z * inverseW * 0.5f + 0.5f;
+    }
+
+    // occluders are closed, their back faces are behind their front faces
+    float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+                 (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+    if (area <= 0.0f)
+    {
+      continue;
+    }
+
+    // pixels whose center can be inside, the first column on a multiple of
+    // 4 for the simd loop
+    float minX = std::min({triangle.x[0], triangle.x[1], triangle.x[2]});
+    float maxX = std::max({triangle.x[0], triangle.x[1], triangle.x[2]});
+    float minY = std::min({triangle.y[0], triangle.y[1], triangle.y[2]});
+    float maxY = std::max({triangle.y[0], triangle.y[1], triangle.y[2]});
+    triangle.minX = std::max(0, (int)ceilf(minX - 0.5f)) & ~3;
+    triangle.maxX = std::min(width - 1, (int)floorf(maxX - 0.5f));
+    triangle.minY = std::max(0, (int)ceilf(minY - 0.5f));
+    triangle.maxY = std::min(height - 1, (int)floorf(maxY - 0.5f));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+    {
+      continue;
+    }
+
+    this->triangles.push_back(triangle);
+  }
+}
+
+void OcclusionCuller::rasterize()
+{
+  this->stats.triangles = this->triangles.size();
+
+  // bands of rows don't share pixels, so each thread takes one
+  int threads = 1;
+  if (this->triangles.size() >= threadedTriangles)
+  {
+    threads = std::min(WorkerPool::shared().size(), height / rowsPerThread);
+  }
+  int perThread = (height + threads - 1) / threads;
+
+  WorkerPool::shared().run((height + perThread - 1) / perThread, [&](int task) {
+    int first = task * perThread;
+    this->rasterizeRows(first, std::min(first + perThread, height));
+  });
+
+  this->buildPyramid();
+}
+
+bool OcclusionCuller::isVisible(const BoundingBox &box, const Mat4x4 &transform)
+{
+  this->stats.tested++;
+  Mat4x4 m = this->viewProjection * transform;
+
+  // corners outside the same clip plane put the whole box outside
+  int outside = 0x3f;
+  bool crossesNear = false;
+  float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f, minZ = 1.0f;
+  for (int c = 0; c < 8; ++c)
+  {
+    Vector4f corner = toClip(m, (c & 1) ? box.maxPt.x : box.minPt.x, (c & 2) ? box.maxPt.y : box.minPt.y,
+                             (c & 4) ? box.maxPt.z : box.minPt.z);
+    int planes = (corner.x < -corner.w) | (corner.x > corner.w) << 1 | (corner.y < -corner.w) << 2 |
+                 (corner.y > corner.w) << 3 | (corner.z < -corner.w) << 4 | (corner.z > corner.w) << 5;
+    outside &= planes;
+    if (corner.z < -corner.w)
+    {
+      crossesNear = true;
+      continue;
+    }
+
+    float inverseW = 1.0f / corner.w;
+    minX = std::min(minX, corner.x * inverseW);
+    maxX = std::max(maxX, corner.x * inverseW);
+    minY = std::min(minY, corner.y * inverseW);
+    maxY = std::max(maxY, corner.y * inverseW);
+    minZ = std::min(minZ, corner.z * inverseW);
+  }
+
+  if (outside != 0)
+  {
+    this->stats.outside++;
+    return false;
+  }
+  // the box reaches the camera, nothing can be in front of all of it
+  if (crossesNear)
+  {
+    return true;
+  }
+
+  int x0 = std::clamp((int)floorf((minX * 0.5f + 0.5f) * (float)width), 0, width - 1);
+  int x1 = std::clamp((int)floorf((maxX * 0.5f + 0.5f) * (float)width), 0, width - 1);
+  int y0 = std::clamp((int)floorf((minY * 0.5f + 0.5f) * (float)height), 0, height - 1);
+  int y1 = std::clamp((int)floorf((maxY * 0.5f + 0.5f) * (float)height), 0, height - 1);
+  float nearest = minZ * 0.5f + 0.5f;
+
+  // the finest level the rectangle covers at most 4x4 texels of
+  int level = 0;
+  while (level < levels - 1 && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4))
+  {
+    level++;
+  }
+
+  const std::vector<float> &depth = this->pyramid[level];
+  int levelWidth = width >> level;
+  float farthest = 0.0f;
+  for (int y = y0 >> level; y <= y1 >> level; ++y)
+  {
+    for (int x = x0 >> level; x <= x1 >> level; ++x)
+    {
+      farthest = std::max(farthest, depth[(size_t)y * levelWidth + x]);
+    }
+  }
+
+  if (nearest > farthest)
+  {
+    this->stats.occluded++;
+    return false;
+  }
+  return true;
+}
+
+const OcclusionStats &OcclusionCuller::getStats() const { return this->stats; }
+
+Mesh OcclusionCuller::simplify(const Mesh &mesh, const BoundingBox &bounds, int cells)
+{
+  Mesh occluder;
+  occluder.mode = TRIANGLES;
+  occluder.skin = mesh.skin;
+  occluder.node = mesh.node;
+
+  Vector3f extent = bounds.maxPt - bounds.minPt;
+  float cellSize = std::max({extent.x, extent.y, extent.z}) / (float)cells;
+  if (cellSize <= 0.0f)
+  {
+    cellSize = 1.0f;
+  }
+
+  std::unordered_map<uint64_t, unsigned int> cellVertices;
+  std::vector<unsigned int> merged(mesh.vertices.size());
+  // normals of the vertices merged into each kept vertex
+  std::vector<Vector3f> cellNormals;
+  for (size_t v = 0; v < mesh.vertices.size(); ++v)
+  {
+    const Vertex &vertex = mesh.vertices[v];
+    uint64_t cell[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      float offset = (axis == 0 ? vertex.pos.x - bounds.minPt.x
+                                : axis == 1 ? vertex.pos.y - bounds.minPt.y : vertex.pos.z - bounds.minPt.z);
+      cell[axis] = (uint64_t)std::clamp((int)(offset / cellSize), 0, cells - 1);
+    }
+    uint64_t key = (cell[0] * cells + cell[1]) * cells + cell[2];
+
+    auto found = cellVertices.find(key);
+    if (found != cellVertices.end())
+    {
+      merged[v] = found->second;
+      cellNormals[found->second] += vertex.norm;
+      continue;
+    }
+
+    Vertex kept = vertex;
+    if (mesh.skin == -1)
+    {
+      kept.weights[0] = 1.0f;
+      kept.joints[0] = 0;
+      for (int i = 1; i < 4; ++i)
+      {
+        kept.weights[i] = 0.0f;
+        kept.joints[i] = -1;
+      }
+    }
+    merged[v] = (unsigned int)occluder.vertices.size();
+    cellVertices.emplace(key, merged[v]);
+    occluder.vertices.push_back(kept);
+    cellNormals.push_back(vertex.norm);
+  }
+
+  // any merged vertex is within a cell diagonal of the kept one, moving
+  // that far inwards keeps the simplified surface behind the real one
+  float inset = cellSize * sqrtf(3.0f);
+  for (size_t v = 0; v < occluder.vertices.size(); ++v)
+  {
+    float length = cellNormals[v].mag();
+    if (length > 1e-6f)
+    {
+      occluder.vertices[v].pos -= cellNormals[v] * (inset / length);
+    }
+  }
+
+  // triangles of merged vertices collapse, others may now repeat
+  std::unordered_set<uint64_t> kept;
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+  {
+    unsigned int corners[3] = {merged[mesh.indices[i]], merged[mesh.indices[i + 1]],
+                               merged[mesh.indices[i + 2]]};
+    if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2])
+    {
+      continue;
+    }
+
+    // the same triangle in any rotation, the winding stays
+    int first = (int)(std::min_element(corners, corners + 3) - corners);
+    uint64_t key = (uint64_t)corners[first] << 42 | (uint64_t)corners[(first + 1) % 3] << 21 |
+                   (uint64_t)corners[(first + 2) % 3];
+    if (!kept.insert(key).second)
+    {
+      continue;
+    }
+    occluder.indices.insert(occluder.indices.end(), corners, corners + 3);
+  }
+
+  occluder.countInfluences();
+  return occluder;
+}
+
+void OcclusionCuller::rasterizeRows(int first, int last)
+{
+  std::vector<float> &depth = this->pyramid[0];
+
+  for (const ScreenTriangle &triangle : this->triangles)
+  {
+    int firstRow = std::max(triangle.minY, first);
+    int lastRow = std::min(triangle.maxY, last - 1);
+    if (firstRow > lastRow)
+    {
+      continue;
+    }
+
+    // edge k runs from corner k to the next, the inside is to its left.
+    // corner k's barycentric weight is the edge across from it over the area
+    float a[3], b[3], c[3];
+    for (int k = 0; k < 3; ++k)
+    {
+      int next = (k + 1) % 3;
+      a[k] = triangle.y[k] - triangle.y[next];
+      b[k] = triangle.x[next] - triangle.x[k];
+      c[k] = triangle.x[k] * triangle.y[next] - triangle.y[k] * triangle.x[next];
+    }
+    float inverseArea = 1.0f / (c[0] + c[1] + c[2]);
+    float zA = (a[1] * triangle.z[0] + a[2] * triangle.z[1] + a[0] * triangle.z[2]) * inverseArea;
+    float zB = (b[1] * triangle.z[0] + b[2] * triangle.z[1] + b[0] * triangle.z[2]) * inverseArea;
+    float zC = (c[1] * triangle.z[0] + c[2] * triangle.z[1] + c[0] * triangle.z[2]) * inverseArea;
+
+    for (int y = firstRow; y <= lastRow; ++y)
+    {
+      float centerY = (float)y + 0.5f;
+      float *row = &depth[(size_t)y * width];
+#ifdef OCCLUSION_SSE
+      const __m128 zero = _mm_setzero_ps();
+      const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+      __m128 edgeA[3], edgeRow[3];
+      for (int k = 0; k < 3; ++k)
+      {
+        edgeA[k] = _mm_set1_ps(a[k]);
+        edgeRow[k] = _mm_set1_ps(b[k] * centerY + c[k]);
+      }
+      __m128 depthA = _mm_set1_ps(zA);
+      __m128 depthRow = _mm_set1_ps(zB * centerY + zC);
+
+      for (int x = triangle.minX; x <= triangle.maxX; x += 4)
+      {
+        __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+        __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]), zero);
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]), zero));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]), zero));
+        if (_mm_movemask_ps(inside) == 0)
+        {
+          continue;
+        }
+
+        __m128 z = _mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow);
+        __m128 stored = _mm_loadu_ps(row + x);
+        __m128 nearer = _mm_min_ps(stored, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+      }
+#else
+      for (int x = triangle.minX; x <= triangle.maxX; ++x)
+      {
+        float centerX = (float)x + 0.5f;
+        if (a[0] * centerX + b[0] * centerY + c[0] >= 0.0f &&
+            a[1] * centerX + b[1] * centerY + c[1] >= 0.0f &&
+            a[2] * centerX + b[2] * centerY + c[2] >= 0.0f)
+        {
+          row[x] = std::min(row[x], zA * centerX + zB * centerY + zC);
+        }
+      }
+#endif
+    }
+  }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+  for (int level = 1; level < levels; ++level)
+  {
+    const std::vector<float> &below = this->pyramid[level - 1];
+    std::vector<float> &depth = this->pyramid[level];
+    int belowWidth = width >> (level - 1);
+    int levelWidth = width >> level;
+    int levelHeight = height >> level;
+
+    for (int y = 0; y < levelHeight; ++y)
+    {
+      const float *top = &below[(size_t)(y * 2) * belowWidth];
+      const float *bottom = top + belowWidth;
+      for (int x = 0; x < levelWidth; ++x)
+      {
+        depth[(size_t)y * levelWidth + x] =
+            std::max(std::max(top[x * 2], top[x * 2 + 1]), std::max(bottom[x * 2], bottom[x * 2 + 1]));
+      }
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include "../../math/mat4.h"
+#include "boundingVolumes.h"
+#include "skinningPass.h"
+#include <cstddef>
+#include <vector>
+
+/// @brief work and results of the last frame
+struct OcclusionStats
+{
+  // occluders added and the triangles of them left to rasterize
+  size_t occluders{0};
+  size_t triangles{0};
+  size_t tested{0};
+  // boxes outside the view and boxes behind the occluders
+  size_t outside{0};
+  size_t occluded{0};
+};
+
+/// @brief software occlusion culling. a few simplified occluder meshes are
+/// rasterized on the cpu into a small depth buffer, 4 pixels at a time
+/// with sse and in bands of rows on the WorkerPool. a pyramid of the
+/// farthest depth of every 2x2 texels is built on top, so a box is tested
+/// against at most 4x4 texels of the level its screen rectangle fits in.
+/// triangles crossing the near plane are dropped and boxes crossing it are
+/// kept. the test is not exact: a texel counts as covered when its center
+/// is, so a box showing through less than a texel past an occluder's
+/// silhouette can still be culled
+class OcclusionCuller
+{
+public:
+  static constexpr int width = 256;
+  static constexpr int height = 128;
+  // down to 2x1 texels
+  static constexpr int levels = 8;
+
+  OcclusionCuller();
+  ~OcclusionCuller() {}
+
+  /// @brief clears the depth buffer and the stats of the previous frame
+  void begin(const Mat4x4 &viewProjection);
+  /// @brief queues the triangles of an occluder for rasterize
+  /// @param transform places the vertices in the world
+  void addOccluder(const std::vector<SkinnedVertex> &vertices, const std::vector<unsigned int> &indices,
+                   const Mat4x4 &transform);
+  /// @brief draws the queued occluders and builds the depth pyramid
+  void rasterize();
+  /// @brief tests a box against the depth pyramid of the last rasterize
+  /// @param transform places the box in the world
+  /// @return false if the box is outside the view or behind the occluders
+  bool isVisible(const BoundingBox &box, const Mat4x4 &transform);
+
+  const OcclusionStats &getStats() const;
+
+  /// @brief simplifies a mesh into an occluder by vertex clustering. the
+  /// vertices falling in the same cell of a cells^3 grid spanning bounds
+  /// merge into the first of them, and the triangles left without area are
+  /// dropped. merging moves the surface by up to a cell diagonal, so every
+  /// kept vertex is pulled that far against the mean normal of its cell,
+  /// which keeps the occluder inside the mesh. parts thinner than two cell
+  /// diagonals turn inside out and are culled as back faces. rigid meshes
+  /// get a single joint of weight 1, so they skin with a one matrix palette
+  /// like skinned ones
+  static struct Mesh simplify(const struct Mesh &mesh, const BoundingBox &bounds, int cells);
+
+private:
+  // triangle in pixels with y up, z is the depth the pyramid stores
+  struct ScreenTriangle
+  {
+    float x[3], y[3], z[3];
+    int minX, maxX, minY, maxY;
+  };
+
+  Mat4x4 viewProjection;
+  std::vector<ScreenTriangle> triangles;
+  // level 0 is the depth buffer, each level holds the farthest depth of
+  // 2x2 texels of the one below
+  std::vector<float> pyramid[levels];
+  // clip space vertices of addOccluder
+  std::vector<Vector4f> clipVertices;
+
+  OcclusionStats stats;
+
+  /// @brief draws every queued triangle over rows first to last - 1
+  void rasterizeRows(int first, int last);
+  void buildPyramid();
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "renderQueue.h"
+#include "material.h"
+#include "mesh.h"
+#include "shader.h"
+#include "glState.h"
+
+#include "../../external/glad/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// bits of each key field, from the top
+static const int programBits = 8;
+static const int textureBits = 16;
+static const int materialBits = 16;
+static const int depthBits = 24;
+
+void RenderQueue::begin()
+{
+  this->items.clear();
+  this->order.clear();
+  this->programs.clear();
+  this->textureSets.clear();
+  this->materials.clear();
+}
+
+void RenderQueue::push(const RenderItem &item, float depth)
+{
+  uint64_t program = this->getProgram(item.shader);
+  uint64_t textures = this->getTextureSet(item.textures);
+  uint64_t material = this->getMaterial(item.material);
+
+  // depth is quantized on a log scale so near draws keep their precision
+  float clamped = std::max(depth, 0.0f);
+  uint64_t quantized = (uint64_t)(std::min(log2f(1.0f + clamped) / 16.0f, 1.0f) *
+                                  (float)((1u << depthBits) - 1));
+
+  SortEntry entry;
+  entry.key = (program << (textureBits + materialBits + depthBits)) |
+              (textures << (materialBits + depthBits)) |
+              (material << depthBits) |
+              quantized;
+  entry.item = (uint32_t)this->items.size();
+
+  this->items.push_back(item);
+  this->order.push_back(entry);
+}
+
+void RenderQueue::submit()
+{
+  this->stats = RenderStats();
+
+  std::sort(this->order.begin(), this->order.end(),
+            [](const SortEntry &a, const SortEntry &b)
+            { return a.key < b.key; });
+
+  // the state left by other code is unknown, so the first draw sets it all
+  Shader *boundShader = nullptr;
+  unsigned int boundTextures[2] = {~0u, ~0u};
+  this->programStates.clear();
+
+  for (const SortEntry &entry : this->order)
+  {
+    const RenderItem &item = this->items[entry.item];
+
+    if (item.shader != boundShader)
+    {
+      item.shader->use();
+      boundShader = item.shader;
+      this->stats.programChanges++;
+    }
+    ProgramState &state = this->getState(item.shader);
+
+    for (int unit = 0; unit < 2; ++unit)
+    {
+      // a material without the texture ignores the unit
+      if (item.textures[unit] != 0 && item.textures[unit] != boundTextures[unit])
+      {
+        GLState::bindTexture(unit, item.textures[unit]);
+        boundTextures[unit] = item.textures[unit];
+        this->stats.textureBinds++;
+      }
+    }
+
+    if (state.material == nullptr || item.material->slot != state.material->slot)
+    {
+      item.material->configShader(*item.shader);
+      this->stats.materialChanges++;
+      this->stats.uniformUploads++;
+    }
+    state.material = item.material;
+
+    if (item.palette != nullptr && item.palette != state.palette)
+    {
+      item.shader->updateMat4Array("boneMats", item.palette, item.paletteSize);
+      state.palette = item.palette;
+      this->stats.uniformUploads++;
+    }
+
+    if (!state.hasTransform || memcmp(&state.transform, &item.transform, sizeof(Mat4x4)) != 0)
+    {
+      item.shader->updateMat4("transform", item.transform);
+      state.transform = item.transform;
+      state.hasTransform = true;
+      this->stats.uniformUploads++;
+    }
+
+    if (item.vao != 0)
+    {
+      item.mesh->draw(item.vao);
+    }
+    else
+    {
+      item.mesh->draw();
+    }
+    this->stats.draws++;
+  }
+}
+
+size_t RenderQueue::size() const { return this->items.size(); }
+
+const RenderStats &RenderQueue::getStats() const { return this->stats; }
+
+uint32_t RenderQueue::getProgram(Shader *shader)
+{
+  for (size_t i = 0; i < this->programs.size(); ++i)
+  {
+    if (this->programs[i] == shader)
+    {
+      return (uint32_t)i;
+    }
+  }
+  this->programs.push_back(shader);
+  return (uint32_t)std::min(this->programs.size() - 1, (size_t)(1u << programBits) - 1);
+}
+
+uint32_t RenderQueue::getTextureSet(const unsigned int textures[2])
+{
+  uint64_t set = ((uint64_t)textures[0] << 32) | textures[1];
+  for (size_t i = 0; i < this->textureSets.size(); ++i)
+  {
+    if (this->textureSets[i] == set)
+    {
+      return (uint32_t)i;
+    }
+  }
+  this->textureSets.push_back(set);
+  return (uint32_t)std::min(this->textureSets.size() - 1, (size_t)(1u << textureBits) - 1);
+}
+
+uint32_t RenderQueue::getMaterial(const Material *material)
+{
+  // materials sharing a slot share an index even when owned by other meshes
+  for (size_t i = 0; i < this->materials.size(); ++i)
+  {
+    if (this->materials[i]->slot == material->slot)
+    {
+      return (uint32_t)i;
+    }
+  }
+  this->materials.push_back(material);
+  return (uint32_t)std::min(this->materials.size() - 1, (size_t)(1u << materialBits) - 1);
+}
+
+RenderQueue::ProgramState &RenderQueue::getState(Shader *shader)
+{
+  for (auto &state : this->programStates)
+  {
+    if (state.shader == shader)
+    {
+      return state;
+    }
+  }
+
+  ProgramState state;
+  state.shader = shader;
+  state.material = nullptr;
+  state.palette = nullptr;
+  state.hasTransform = false;
+  this->programStates.push_back(state);
+  return this->programStates.back();
+}
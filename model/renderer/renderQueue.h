@@ -0,0 +1,97 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include "../../math/mat4.h"
+#include <cstdint>
+#include <vector>
+
+/// @brief state changes made by RenderQueue::submit in one frame
+struct RenderStats
+{
+  size_t draws{0};
+  size_t programChanges{0};
+  size_t textureBinds{0};
+  size_t materialChanges{0};
+  // individual glUniform calls
+  size_t uniformUploads{0};
+};
+
+/// @brief one recorded draw, everything submit needs to set before it
+struct RenderItem
+{
+  class Shader *shader;
+  struct Mesh *mesh;
+  const struct Material *material;
+  // base color and metallic textures, 0 when the material has none
+  unsigned int textures[2];
+  Mat4x4 transform;
+  // uploaded to boneMats, nullptr for rigid draws. must stay alive until
+  // submit
+  const Mat4x4 *palette;
+  int paletteSize;
+  // drawn from instead of the mesh's VAO when not 0
+  unsigned int vao;
+};
+
+/// @brief draws of every visible model recorded during the frame, then
+/// sorted by a 64 bit key so consecutive draws share as much state as
+/// possible. from the most to the least significant bits the key holds the
+/// program, the texture set, the material and the front to back depth.
+/// textures come before materials since a bind costs more than the material
+/// index uniform
+class RenderQueue
+{
+public:
+  RenderQueue() {}
+  ~RenderQueue() {}
+
+  /// @brief drops the draws of the previous frame
+  void begin();
+  /// @param depth distance to the camera, near draws go first within a
+  /// state group
+  void push(const RenderItem &item, float depth);
+  /// @brief sorts and issues every recorded draw, skipping state that is
+  /// already set
+  void submit();
+
+  size_t size() const;
+  /// @brief changes made by the last submit
+  const RenderStats &getStats() const;
+
+private:
+  struct SortEntry
+  {
+    uint64_t key;
+    uint32_t item;
+  };
+
+  /// @brief uniforms last uploaded to a program, programs keep their
+  /// uniforms while other programs are bound
+  struct ProgramState
+  {
+    class Shader *shader;
+    const struct Material *material;
+    const Mat4x4 *palette;
+    Mat4x4 transform;
+    bool hasTransform;
+  };
+
+  std::vector<RenderItem> items;
+  std::vector<SortEntry> order;
+
+  // distinct programs, texture sets and materials of the frame, their index
+  // is their field of the key
+  std::vector<class Shader *> programs;
+  std::vector<uint64_t> textureSets;
+  std::vector<const struct Material *> materials;
+
+  std::vector<ProgramState> programStates;
+  RenderStats stats;
+
+  uint32_t getProgram(class Shader *shader);
+  uint32_t getTextureSet(const unsigned int textures[2]);
+  uint32_t getMaterial(const struct Material *material);
+  ProgramState &getState(class Shader *shader);
+};
+
+#endif
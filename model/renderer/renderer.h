@@ -3,3 +3,12 @@
 #include "texture.h"
 #include "material.h"
 #include "boundingVolumes.h"
+#include "animationTexture.h"
+#include "geometryPool.h"
+#include "renderQueue.h"
+#include "glState.h"
+#include "materialBuffer.h"
+#include "textureArrays.h"
+#include "skinningPass.h"
+#include "cpuSkinning.h"
+#include "occlusionCuller.h"
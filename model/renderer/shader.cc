@@ -1,17 +1,124 @@
 #include "../../external/glad/glad.h"
 
+#include <cstdint>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "shader.h"
+#include "glState.h"
+
+// GL_KHR_parallel_shader_compile, not in the core profile glad loads
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static const char *cacheDirectory = "shaderCache";
+static const uint32_t cacheMagic = 0x31485344; // DSH1
+
+/// @brief start of a cache file, the program binary follows
+struct CacheHeader
+{
+  uint32_t magic;
+  GLenum format;
+  uint32_t length;
+};
+
+static std::string readSource(const char *path)
+{
+  std::ifstream file;
+  file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  try
+  {
+    file.open(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
+  }
+  catch (std::ifstream::failure &e)
+  {
+    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << "\n";
+  }
+  return "";
+}
+
+/// @brief puts defines right after the #version line, which has to come
+/// first
+static std::string insertDefines(const std::string &source, const std::string &defines)
+{
+  if (defines.empty())
+  {
+    return source;
+  }
+  size_t version = source.find("#version");
+  size_t line = version == std::string::npos ? 0 : source.find('\n', version);
+  if (line == std::string::npos)
+  {
+    return source + "\n" + defines;
+  }
+  if (version != std::string::npos)
+  {
+    line++;
+  }
+  return source.substr(0, line) + defines + source.substr(line);
+}
+
+/// @brief 64 bit FNV-1a
+static uint64_t hashString(const std::string &string, uint64_t hash)
+{
+  for (unsigned char c : string)
+  {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+/// @brief vendor, renderer and version of the driver
+static const std::string &getDriver()
+{
+  static std::string driver;
+  if (driver.empty())
+  {
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+      const GLubyte *value = glGetString(name);
+      driver += value != nullptr ? (const char *)value : "";
+      driver += "\n";
+    }
+  }
+  return driver;
+}
+
+static bool hasParallelCompile()
+{
+  static int supported = -1;
+  if (supported == -1)
+  {
+    supported = 0;
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+      const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+      if (extension != nullptr && (std::string(extension) == "GL_KHR_parallel_shader_compile" ||
+                                   std::string(extension) == "GL_ARB_parallel_shader_compile"))
+      {
+        supported = 1;
+      }
+    }
+  }
+  return supported == 1;
+}
 
 Shader::Shader(const char *vert_path, const char *frag_path) : program(0)
 {
   load(vert_path, frag_path);
 }
 
-void Shader::use() { glUseProgram(program); }
+void Shader::use() { GLState::useProgram(program); }
 void Shader::clean() { glDeleteProgram(program); }
 
 void Shader::updateMat4(const char *name, const Mat4x4 &mat)
@@ -19,6 +126,11 @@ void Shader::updateMat4(const char *name, const Mat4x4 &mat)
   unsigned int location = glGetUniformLocation(program, name);
   glUniformMatrix4fv(location, 1, true, &mat.rc[0][0]);
 }
+void Shader::updateMat4Array(const char *name, const Mat4x4 *mats, int count)
+{
+  unsigned int location = glGetUniformLocation(program, name);
+  glUniformMatrix4fv(location, count, true, &mats[0].rc[0][0]);
+}
 void Shader::updateVec3(const char *name, const Vector3f &vec)
 {
   unsigned int location = glGetUniformLocation(program, name);
@@ -36,38 +148,38 @@ void Shader::updateInt(const char *name, int value)
 }
 void Shader::load(const char *vert_path, const char *frag_path)
 {
-  std::string vertexcode;
-  std::string fragmentcode;
-  std::ifstream vShaderFile;
-  std::ifstream fShaderFile;
-
-  vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-  fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-  try
-  {
-    vShaderFile.open(vert_path);
-    fShaderFile.open(frag_path);
+  compile(vert_path, frag_path);
+  finish();
+}
 
-    std::stringstream vshaderstream, fshaderstream;
+void Shader::compile(const char *vert_path, const char *frag_path, const std::string &defines)
+{
+  vertPath = vert_path;
+  fragPath = frag_path;
+  cached = false;
+  pending = true;
 
-    vshaderstream << vShaderFile.rdbuf();
-    fshaderstream << fShaderFile.rdbuf();
+  std::string vertexcode = insertDefines(readSource(vert_path), defines);
+  std::string fragmentcode = insertDefines(readSource(frag_path), defines);
 
-    vShaderFile.close();
-    fShaderFile.close();
+  // the same sources build different binaries on other drivers
+  uint64_t hash = hashString(vertexcode, 14695981039346656037ull);
+  hash = hashString(fragmentcode, hash);
+  hash = hashString(getDriver(), hash);
+  std::stringstream name;
+  name << cacheDirectory << "/" << std::hex << hash << ".bin";
+  cachePath = name.str();
 
-    vertexcode = vshaderstream.str();
-    fragmentcode = fshaderstream.str();
-  }
-  catch (std::ifstream::failure &e)
+  program = glCreateProgram();
+  if (loadBinary())
   {
-    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ\n";
+    cached = true;
+    return;
   }
+
   const GLchar *vshadercode = vertexcode.c_str();
   const char *fshadercode = fragmentcode.c_str();
 
-  unsigned int vertex, fragment;
   vertex = glCreateShader(GL_VERTEX_SHADER);
   glShaderSource(vertex, 1, &vshadercode, NULL);
   glCompileShader(vertex);
@@ -76,11 +188,214 @@ void Shader::load(const char *vert_path, const char *frag_path)
   glShaderSource(fragment, 1, &fshadercode, NULL);
   glCompileShader(fragment);
 
-  program = glCreateProgram();
   glAttachShader(program, vertex);
   glAttachShader(program, fragment);
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  // status isn't queried here, that would wait for the driver
   glLinkProgram(program);
+}
+
+bool Shader::isReady()
+{
+  if (cached || !hasParallelCompile())
+  {
+    return true;
+  }
+  GLint done = GL_TRUE;
+  glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+  return done == GL_TRUE;
+}
+
+bool Shader::finish()
+{
+  if (!pending)
+  {
+    return program != 0;
+  }
+  pending = false;
+  if (cached)
+  {
+    return true;
+  }
+
+  bool compiled = checkShader(vertex, vertPath) & checkShader(fragment, fragPath);
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (compiled && linked != GL_TRUE)
+  {
+    GLchar log[1024];
+    glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED " << vertPath << " " << fragPath << "\n"
+              << log << std::endl;
+  }
 
+  glDetachShader(program, vertex);
+  glDetachShader(program, fragment);
   glDeleteShader(vertex);
   glDeleteShader(fragment);
+  vertex = 0;
+  fragment = 0;
+
+  if (linked == GL_TRUE)
+  {
+    saveBinary();
+  }
+  return linked == GL_TRUE;
+}
+
+bool Shader::checkShader(unsigned int shader, const std::string &path)
+{
+  GLint compiled = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+  if (compiled != GL_TRUE)
+  {
+    GLchar log[1024];
+    glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    std::cout << "ERROR::SHADER::COMPILATION_FAILED " << path << "\n"
+              << log << std::endl;
+  }
+  return compiled == GL_TRUE;
+}
+
+bool Shader::loadBinary()
+{
+  std::ifstream file(cachePath, std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+
+  CacheHeader header;
+  file.read((char *)&header, sizeof(header));
+  if (!file || header.magic != cacheMagic)
+  {
+    return false;
+  }
+  std::vector<char> binary(header.length);
+  file.read(binary.data(), header.length);
+  if (!file)
+  {
+    return false;
+  }
+
+  // a driver update can refuse binaries it wrote itself, the program is
+  // then compiled from source and cached again
+  glProgramBinary(program, header.format, binary.data(), (GLsizei)header.length);
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  return linked == GL_TRUE;
+}
+
+void Shader::saveBinary()
+{
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (formats == 0 || length <= 0)
+  {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  CacheHeader header;
+  header.magic = cacheMagic;
+  glGetProgramBinary(program, length, NULL, &header.format, binary.data());
+  header.length = (uint32_t)length;
+
+  std::error_code error;
+  std::filesystem::create_directories(cacheDirectory, error);
+  std::ofstream file(cachePath, std::ios::binary);
+  if (!file)
+  {
+    std::cout << "shader cache: can't write " << cachePath << std::endl;
+    return;
+  }
+  file.write((const char *)&header, sizeof(header));
+  file.write(binary.data(), length);
+}
+
+uint32_t ShaderFeatures::key() const
+{
+  // texture states go from -1..1 to 0..2
+  return (uint32_t)(skinned ? 1 : 0) |
+         ((uint32_t)boneInfluences << 1) |
+         ((uint32_t)(baseTexture + 1) << 4) |
+         ((uint32_t)(metallicMap + 1) << 6) |
+         ((uint32_t)maxLights << 8);
+}
+
+std::string ShaderFeatures::defines() const
+{
+  std::stringstream defines;
+  if (skinned)
+  {
+    defines << "#define SKINNED\n";
+    defines << "#define BONE_INFLUENCES " << boneInfluences << "\n";
+  }
+  if (baseTexture != -1)
+  {
+    defines << "#define HAS_BASE_TEX " << baseTexture << "\n";
+  }
+  if (metallicMap != -1)
+  {
+    defines << "#define HAS_METALLIC_MAP " << metallicMap << "\n";
+  }
+  defines << "#define MAX_LIGHTS " << maxLights << "\n";
+  return defines.str();
+}
+
+ShaderVariants::ShaderVariants(const char *vert_path, const char *frag_path,
+                               bool materialFeatures)
+    : vertPath(vert_path), fragPath(frag_path), materialFeatures(materialFeatures)
+{
+}
+
+ShaderFeatures ShaderVariants::filter(const ShaderFeatures &features) const
+{
+  ShaderFeatures filtered = features;
+  if (!materialFeatures)
+  {
+    filtered.baseTexture = -1;
+    filtered.metallicMap = -1;
+  }
+  return filtered;
+}
+
+void ShaderVariants::prepare(const ShaderFeatures &wanted)
+{
+  ShaderFeatures features = filter(wanted);
+  uint32_t key = features.key();
+  if (variants.find(key) != variants.end())
+  {
+    return;
+  }
+
+  Shader *shader = new Shader();
+  shader->compile(vertPath.c_str(), fragPath.c_str(), features.defines());
+  variants[key] = shader;
+  shaders.push_back(shader);
+}
+
+Shader *ShaderVariants::get(const ShaderFeatures &features)
+{
+  prepare(features);
+  Shader *shader = variants[filter(features).key()];
+  shader->finish();
+  return shader;
+}
+
+const std::vector<Shader *> &ShaderVariants::getShaders() const { return shaders; }
+
+void ShaderVariants::clean()
+{
+  for (Shader *shader : shaders)
+  {
+    shader->finish();
+    shader->clean();
+    delete shader;
+  }
+  shaders.clear();
+  variants.clear();
 }
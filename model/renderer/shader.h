@@ -3,8 +3,18 @@
 
 #include "../../math/mat4.h"
 #include "../../math/vec3.h"
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+/// @brief glsl program built from a vertex and a fragment shader file.
+/// linked programs are cached as driver binaries in shaderCache/, keyed by
+/// a hash of the sources and the driver, so warm runs skip compiling.
+/// compile only starts the build, so several programs can be compiled at
+/// once (in parallel when the driver has GL_KHR_parallel_shader_compile)
+/// before the first finish waits for any of them
 class Shader
 {
 public:
@@ -16,13 +26,90 @@ public:
 
   void use();
   void clean();
+  /// @brief compile and finish in one go
   void load(const char *vert_path, const char *frag_path);
 
+  /// @brief loads the cached binary of the program or starts compiling it,
+  /// the program can't be used before finish
+  /// @param defines inserted after the #version line of both sources
+  void compile(const char *vert_path, const char *frag_path, const std::string &defines = "");
+  /// @brief true once finish won't block, always true without
+  /// GL_KHR_parallel_shader_compile
+  bool isReady();
+  /// @brief waits for the program, reports compile and link errors and
+  /// caches the binary of programs compiled from source
+  /// @return true if the program linked
+  bool finish();
+
   void updateInt(const char *name, int value);
   void updateFloat(const char *name, float value);
   void updateVec3(const char *name, const Vector3f &vec);
   void updateMat4(const char *name, const Mat4x4 &mat);
+  /// @brief uploads count matrices to a mat4 array uniform in one call
+  void updateMat4Array(const char *name, const Mat4x4 *mats, int count);
 
 private:
+  // shaders being compiled, 0 once linked or when loaded from the cache
+  unsigned int vertex{0};
+  unsigned int fragment{0};
+  std::string vertPath;
+  std::string fragPath;
+  // cache file of the program
+  std::string cachePath;
+  bool cached{false};
+  // compiled but not finished
+  bool pending{false};
+
+  bool checkShader(unsigned int shader, const std::string &path);
+  bool loadBinary();
+  void saveBinary();
+};
+
+/// @brief features compiled into a variant of a program as #defines, so a
+/// draw runs a program without the branches it doesn't need
+struct ShaderFeatures
+{
+  // SKINNED, the vertices follow boneInfluences joints (BONE_INFLUENCES)
+  bool skinned{false};
+  int boneInfluences{4};
+  // HAS_BASE_TEX and HAS_METALLIC_MAP, -1 leaves them to the material flags
+  int baseTexture{-1};
+  int metallicMap{-1};
+  // MAX_LIGHTS
+  int maxLights{20};
+
+  /// @brief unique for every combination of features
+  uint32_t key() const;
+  std::string defines() const;
+};
+
+/// @brief variants of a vertex and fragment shader pair, each compiled
+/// once and kept by the key of its features
+class ShaderVariants
+{
+public:
+  /// @param materialFeatures false for programs that don't shade, like
+  /// depth only ones, so materials don't split them into variants
+  ShaderVariants(const char *vert_path, const char *frag_path, bool materialFeatures = true);
+  ~ShaderVariants() {}
+
+  /// @brief starts compiling the variant if it doesn't exist yet, so
+  /// several variants can build at once
+  void prepare(const ShaderFeatures &features);
+  /// @brief the variant with the features, compiled and finished if needed
+  Shader *get(const ShaderFeatures &features);
+  /// @brief every variant built so far, for uniforms shared by all of them
+  const std::vector<Shader *> &getShaders() const;
+  void clean();
+
+private:
+  /// @brief features without those the variants ignore
+  ShaderFeatures filter(const ShaderFeatures &features) const;
+
+  std::string vertPath;
+  std::string fragPath;
+  bool materialFeatures;
+  std::unordered_map<uint32_t, Shader *> variants;
+  std::vector<Shader *> shaders;
 };
 #endif
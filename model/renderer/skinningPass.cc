@@ -0,0 +1,131 @@
+#include "skinningPass.h"
+#include "geometryPool.h"
+#include "mesh.h"
+#include "glState.h"
+
+#include "../../external/glad/glad.h"
+#include <cstddef>
+
+SkinningPass::SkinningPass()
+    : VAO(0), programs("shaders/skin.vert", "shaders/depth.frag", false), buffer(0), feedback(0),
+      poolVAO(0), vertexCount(0)
+{
+}
+
+void SkinningPass::resize(GeometryPool &pool)
+{
+  if (pool.VAO == 0)
+  {
+    return;
+  }
+
+  if (this->VAO == 0)
+  {
+    glCreateVertexArrays(1, &this->VAO);
+    glCreateBuffers(1, &this->buffer);
+    glCreateTransformFeedbacks(1, &this->feedback);
+  }
+
+  this->poolVAO = pool.VAO;
+  this->vertexCount = pool.vertexCount();
+  glNamedBufferData(this->buffer, this->vertexCount * sizeof(SkinnedVertex), nullptr,
+                    GL_DYNAMIC_COPY);
+
+  // positions and normals come from the pass, the rest of the vertex
+  // from the pool
+  glVertexArrayVertexBuffer(this->VAO, 0, this->buffer, 0, sizeof(SkinnedVertex));
+  glVertexArrayVertexBuffer(this->VAO, 1, pool.VBO, 0, sizeof(Vertex));
+  glVertexArrayElementBuffer(this->VAO, pool.EBO);
+
+  glVertexArrayAttribFormat(this->VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(SkinnedVertex, pos));
+  glVertexArrayAttribFormat(this->VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(SkinnedVertex, norm));
+  glVertexArrayAttribFormat(this->VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tc));
+  glVertexArrayAttribBinding(this->VAO, 0, 0);
+  glVertexArrayAttribBinding(this->VAO, 1, 0);
+  glVertexArrayAttribBinding(this->VAO, 2, 1);
+  for (uint attrib = 0; attrib < 3; ++attrib)
+  {
+    glEnableVertexArrayAttrib(this->VAO, attrib);
+  }
+}
+
+void SkinningPass::prepare(const Mesh &mesh)
+{
+  if (mesh.skin != -1 && mesh.pooled)
+  {
+    this->programs.prepare(getFeatures(mesh));
+  }
+}
+
+void SkinningPass::begin()
+{
+  GLState::setEnabled(GL_RASTERIZER_DISCARD, true);
+  GLState::bindVertexArray(this->poolVAO);
+  glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, this->feedback);
+}
+
+void SkinningPass::skin(const Mesh &mesh, const Mat4x4 *palette, int count)
+{
+  if (!mesh.pooled || mesh.baseVertex + mesh.vertices.size() > this->vertexCount)
+  {
+    return;
+  }
+
+  Shader *shader = this->programs.get(getFeatures(mesh));
+  shader->use();
+  shader->updateMat4Array("boneMats", palette, count);
+
+  // the mesh's vertices land at the same index they have in the pool
+  glTransformFeedbackBufferRange(this->feedback, 0, this->buffer,
+                                 mesh.baseVertex * sizeof(SkinnedVertex),
+                                 mesh.vertices.size() * sizeof(SkinnedVertex));
+  glBeginTransformFeedback(GL_POINTS);
+  glDrawArrays(GL_POINTS, mesh.baseVertex, (GLsizei)mesh.vertices.size());
+  glEndTransformFeedback();
+
+  this->stats.meshes++;
+  this->stats.vertices += mesh.vertices.size();
+}
+
+void SkinningPass::end()
+{
+  glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+  GLState::setEnabled(GL_RASTERIZER_DISCARD, false);
+}
+
+void SkinningPass::upload(const Mesh &mesh, const SkinnedVertex *vertices)
+{
+  if (!mesh.pooled || mesh.baseVertex + mesh.vertices.size() > this->vertexCount)
+  {
+    return;
+  }
+
+  glNamedBufferSubData(this->buffer, mesh.baseVertex * sizeof(SkinnedVertex),
+                       mesh.vertices.size() * sizeof(SkinnedVertex), vertices);
+
+  this->stats.meshes++;
+  this->stats.vertices += mesh.vertices.size();
+}
+
+void SkinningPass::beginFrame() { this->stats = SkinningStats(); }
+
+const SkinningStats &SkinningPass::getStats() const { return this->stats; }
+
+void SkinningPass::clean()
+{
+  this->programs.clean();
+  glDeleteVertexArrays(1, &this->VAO);
+  glDeleteBuffers(1, &this->buffer);
+  glDeleteTransformFeedbacks(1, &this->feedback);
+  this->VAO = 0;
+  this->buffer = 0;
+  this->feedback = 0;
+}
+
+ShaderFeatures SkinningPass::getFeatures(const Mesh &mesh)
+{
+  ShaderFeatures features;
+  features.skinned = true;
+  features.boneInfluences = mesh.influences;
+  return features;
+}
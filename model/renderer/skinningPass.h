@@ -0,0 +1,67 @@
+#ifndef SKINNINGPASS_H
+#define SKINNINGPASS_H
+
+#include "../../math/mat4.h"
+#include "shader.h"
+#include <cstddef>
+
+/// @brief skinned vertex written by the skinning pass
+struct SkinnedVertex
+{
+  float pos[3];
+  float norm[3];
+};
+
+/// @brief what the last frame skinned
+struct SkinningStats
+{
+  size_t meshes{0};
+  size_t vertices{0};
+};
+
+/// @brief skins pooled meshes once per frame with transform feedback, so
+/// every pass after it (depth prepass, color pass) draws them as rigid
+/// geometry instead of skinning them again. the output buffer is numbered
+/// like the GeometryPool's vertices, so a mesh keeps its firstIndex and
+/// baseVertex when it draws through VAO
+class SkinningPass
+{
+public:
+  SkinningPass();
+  ~SkinningPass() {}
+
+  /// @brief sizes the output to the pool and builds VAO, call after every
+  /// upload of the pool
+  void resize(class GeometryPool &pool);
+  /// @brief starts compiling the program that will skin the mesh
+  void prepare(const struct Mesh &mesh);
+
+  /// @brief turns off rasterization and binds the feedback buffer
+  void begin();
+  /// @brief skins a pooled mesh into the output with palette
+  void skin(const struct Mesh &mesh, const Mat4x4 *palette, int count);
+  void end();
+  /// @brief writes vertices skinned elsewhere, like by CpuSkinning, where
+  /// skin would have put them
+  void upload(const struct Mesh &mesh, const SkinnedVertex *vertices);
+
+  /// @brief clears the stats, call once per frame
+  void beginFrame();
+  const SkinningStats &getStats() const;
+  void clean();
+
+  // skinned positions and normals, texture coordinates from the pool
+  unsigned int VAO;
+
+private:
+  ShaderVariants programs;
+  unsigned int buffer;
+  unsigned int feedback;
+  unsigned int poolVAO;
+  size_t vertexCount;
+  SkinningStats stats;
+
+  static ShaderFeatures getFeatures(const struct Mesh &mesh);
+};
+
+#endif
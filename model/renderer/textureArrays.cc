@@ -0,0 +1,177 @@
+#include "textureArrays.h"
+#include "texture.h"
+#include "glState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+int TextureArrays::add(const Texture &texture)
+{
+  if (texture.id == 0 || texture.width <= 0 || texture.height <= 0)
+  {
+    return -1;
+  }
+
+  if (this->maxLayers == 0)
+  {
+    GLint layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &layers);
+    // references keep the layer in the low 16 bits
+    this->maxLayers = std::min(std::max((int)layers, 1), 65536);
+  }
+
+  int index = this->findArray(texture.width, texture.height);
+  if (index == -1)
+  {
+    std::cout << "texture arrays: all " << maxArrays << " arrays hold " << this->maxLayers
+              << " layers, texture " << texture.id << " left out" << std::endl;
+    return -1;
+  }
+  Array &array = this->arrays[index];
+
+  Pending copy;
+  copy.texture = texture.id;
+  copy.width = texture.width;
+  copy.height = texture.height;
+  copy.reference = index * 65536 + array.layers;
+  array.layers++;
+
+  this->pending.push_back(copy);
+  return copy.reference;
+}
+
+void TextureArrays::build()
+{
+  if (this->pending.empty())
+  {
+    return;
+  }
+
+  for (auto &array : this->arrays)
+  {
+    if (array.layers > array.capacity)
+    {
+      this->grow(array);
+    }
+  }
+
+  if (this->readFramebuffer == 0)
+  {
+    glCreateFramebuffers(1, &this->readFramebuffer);
+    glCreateFramebuffers(1, &this->drawFramebuffer);
+  }
+
+  // a blit converts the source format and scales textures that landed in
+  // an array of another size
+  for (const Pending &copy : this->pending)
+  {
+    Array &array = this->arrays[copy.reference / 65536];
+    glNamedFramebufferTexture(this->readFramebuffer, GL_COLOR_ATTACHMENT0, copy.texture, 0);
+    glNamedFramebufferTextureLayer(this->drawFramebuffer, GL_COLOR_ATTACHMENT0, array.id, 0,
+                                   copy.reference % 65536);
+    glBlitNamedFramebuffer(this->readFramebuffer, this->drawFramebuffer, 0, 0, copy.width,
+                           copy.height, 0, 0, array.width, array.height, GL_COLOR_BUFFER_BIT,
+                           GL_LINEAR);
+  }
+  this->pending.clear();
+
+  for (auto &array : this->arrays)
+  {
+    glGenerateTextureMipmap(array.id);
+  }
+}
+
+void TextureArrays::bind(unsigned int firstUnit)
+{
+  for (size_t i = 0; i < this->arrays.size(); ++i)
+  {
+    GLState::bindTexture(firstUnit + (unsigned int)i, this->arrays[i].id);
+  }
+}
+
+size_t TextureArrays::memory() const
+{
+  size_t bytes = 0;
+  for (auto &array : this->arrays)
+  {
+    // a full mip chain adds a third
+    bytes += (size_t)array.width * array.height * 4 * array.capacity * 4 / 3;
+  }
+  return bytes;
+}
+
+void TextureArrays::clean()
+{
+  for (auto &array : this->arrays)
+  {
+    glDeleteTextures(1, &array.id);
+  }
+  this->arrays.clear();
+  glDeleteFramebuffers(1, &this->readFramebuffer);
+  glDeleteFramebuffers(1, &this->drawFramebuffer);
+  this->readFramebuffer = 0;
+  this->drawFramebuffer = 0;
+}
+
+int TextureArrays::findArray(int width, int height)
+{
+  int closest = -1;
+  int closestDistance = 0;
+  for (size_t i = 0; i < this->arrays.size(); ++i)
+  {
+    const Array &array = this->arrays[i];
+    if (array.layers >= this->maxLayers)
+    {
+      continue;
+    }
+    int distance = std::abs(array.width - width) + std::abs(array.height - height);
+    if (closest == -1 || distance < closestDistance)
+    {
+      closest = (int)i;
+      closestDistance = distance;
+    }
+  }
+
+  if (closest != -1 && (closestDistance == 0 || (int)this->arrays.size() == maxArrays))
+  {
+    return closest;
+  }
+  if ((int)this->arrays.size() == maxArrays)
+  {
+    return -1;
+  }
+
+  Array array;
+  array.id = 0;
+  array.width = width;
+  array.height = height;
+  array.capacity = 0;
+  array.layers = 0;
+  this->arrays.push_back(array);
+  return (int)this->arrays.size() - 1;
+}
+
+void TextureArrays::grow(Array &array)
+{
+  int levels = 1 + (int)floorf(log2f((float)std::max(array.width, array.height)));
+
+  unsigned int id = 0;
+  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+  glTextureStorage3D(id, levels, GL_RGBA8, array.width, array.height, array.layers);
+  glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  // layers filled by earlier builds move over, mips are rebuilt afterwards
+  if (array.id != 0)
+  {
+    glCopyImageSubData(array.id, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, id, GL_TEXTURE_2D_ARRAY, 0, 0,
+                       0, 0, array.width, array.height, array.capacity);
+    glDeleteTextures(1, &array.id);
+  }
+
+  array.id = id;
+  array.capacity = array.layers;
+}
@@ -0,0 +1,68 @@
+#ifndef TEXTUREARRAYS_H
+#define TEXTUREARRAYS_H
+
+#include <cstddef>
+#include <vector>
+
+/// @brief every material texture copied into a few RGBA8
+/// GL_TEXTURE_2D_ARRAYs, one per texture size, so draws select textures by
+/// layer through the material buffer instead of binding them. once every
+/// array is taken, textures of other sizes are scaled into the array whose
+/// size is closest and still has a layer free under
+/// GL_MAX_ARRAY_TEXTURE_LAYERS.
+/// a reference to a texture is its array * 65536 + its layer
+class TextureArrays
+{
+public:
+  // sampler2DArrays declared by pbr.frag
+  static const int maxArrays = 4;
+
+  TextureArrays() : readFramebuffer(0), drawFramebuffer(0), maxLayers(0) {}
+  ~TextureArrays() {}
+
+  /// @brief queues a texture to be copied by the next build
+  /// @return reference to the texture's layer, -1 for empty textures and
+  /// when every array is full
+  int add(const class Texture &texture);
+  /// @brief grows the arrays and copies the queued textures into them, the
+  /// queued textures can be deleted afterwards
+  void build();
+  /// @brief binds array i to unit firstUnit + i
+  void bind(unsigned int firstUnit);
+
+  /// @brief bytes allocated for the arrays, mips included
+  size_t memory() const;
+  void clean();
+
+private:
+  struct Array
+  {
+    unsigned int id;
+    int width;
+    int height;
+    // layers allocated in id
+    int capacity;
+    // layers handed out by add
+    int layers;
+  };
+  struct Pending
+  {
+    unsigned int texture;
+    int width;
+    int height;
+    int reference;
+  };
+
+  std::vector<Array> arrays;
+  std::vector<Pending> pending;
+  unsigned int readFramebuffer;
+  unsigned int drawFramebuffer;
+  // layers an array can hold, queried on the first add
+  int maxLayers;
+
+  /// @return the array to add a texture to, -1 if every array is full
+  int findArray(int width, int height);
+  void grow(Array &array);
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "workerPool.h"
+#include <algorithm>
+
+WorkerPool &WorkerPool::shared()
+{
+  static WorkerPool pool((int)std::max(1u, std::thread::hardware_concurrency()));
+  return pool;
+}
+
+WorkerPool::WorkerPool(int threads)
+    : job(nullptr), tasks(0), next(0), generation(0), active(0), stop(false)
+{
+  // the caller works too, so one thread fewer is started
+  for (int i = 1; i < threads; ++i)
+  {
+    this->workers.emplace_back(&WorkerPool::workerLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stop = true;
+  }
+  this->wake.notify_all();
+  for (auto &worker : this->workers)
+  {
+    worker.join();
+  }
+}
+
+void WorkerPool::run(int tasks, const std::function<void(int)> &task)
+{
+  if (this->workers.empty() || tasks <= 1)
+  {
+    for (int i = 0; i < tasks; ++i)
+    {
+      task(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> jobLock(this->jobMutex);
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->job = &task;
+    this->tasks = tasks;
+    this->next = 0;
+    // every worker wakes for every job, so none can still be on the
+    // previous one when the next is published
+    this->active = (int)this->workers.size();
+    ++this->generation;
+  }
+  this->wake.notify_all();
+
+  this->work();
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->finished.wait(lock, [this] { return this->active == 0; });
+  this->job = nullptr;
+}
+
+int WorkerPool::size() const { return (int)this->workers.size() + 1; }
+
+void WorkerPool::workerLoop()
+{
+  unsigned int seen = 0;
+  for (;;)
+  {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->wake.wait(lock, [&] { return this->stop || this->generation != seen; });
+    if (this->stop)
+    {
+      return;
+    }
+    seen = this->generation;
+    lock.unlock();
+
+    this->work();
+
+    lock.lock();
+    if (--this->active == 0)
+    {
+      this->finished.notify_one();
+    }
+  }
+}
+
+void WorkerPool::work()
+{
+  for (int i = this->next++; i < this->tasks; i = this->next++)
+  {
+    (*this->job)(i);
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief threads started once and shared by the per frame jobs, light
+/// assignment, cpu skinning and occlusion rasterizing, so a frame doesn't
+/// pay for creating and joining threads. a job is split into tasks the
+/// workers and the calling thread take one at a time. jobs run one after
+/// the other, a task must not run a job of its own
+class WorkerPool
+{
+public:
+  /// @brief the pool of the process, one thread per core with the caller
+  static WorkerPool &shared();
+
+  explicit WorkerPool(int threads);
+  ~WorkerPool();
+
+  /// @brief calls task(0) to task(tasks - 1) and returns once all are done
+  void run(int tasks, const std::function<void(int)> &task);
+  /// @brief threads working on a job, the caller included
+  int size() const;
+
+private:
+  std::vector<std::thread> workers;
+
+  // serializes jobs from different threads
+  std::mutex jobMutex;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+
+  // the job, written under mutex before generation changes
+  const std::function<void(int)> *job;
+  int tasks;
+  std::atomic<int> next;
+  // bumped for every job, workers wait for it to change
+  unsigned int generation;
+  // workers yet to finish the current job
+  int active;
+  bool stop;
+
+  void workerLoop();
+  /// @brief takes tasks of the current job until none are left
+  void work();
+};
+
+#endif
@@ -0,0 +1,6 @@
+#version 460
+
+// depth prepass, the fixed function depth write is all the draw does
+
+void main() {
+}
@@ -0,0 +1,61 @@
+#version 460
+
+// pooled meshes drawn by Model::renderIndirect, every draw of a multi draw
+// finds its transform and palette through its base instance
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tc;
+layout(location = 3) in vec4 weights;
+layout(location = 4) in ivec4 boneIds;
+
+struct DrawData {
+    mat4 transform;
+    // x first matrix of the draw in the bone buffer, y set for rigid meshes,
+    // z material buffer index
+    ivec4 palette;
+};
+
+layout(std430, row_major, binding = 1) readonly buffer Bones {
+    mat4 bones[];
+};
+
+layout(std430, row_major, binding = 2) readonly buffer Draws {
+    DrawData draws[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 normal;
+out vec3 fragPos;
+out vec2 texCoords;
+out vec3 tint;
+// the depth prepass and the color pass must compute the same depth
+invariant gl_Position;
+flat out int materialId;
+
+void main() {
+    DrawData draw = draws[gl_BaseInstance];
+    int base = draw.palette.x;
+
+    mat4 skin;
+    if (draw.palette.y != 0) {
+        skin = bones[base];
+    } else {
+        skin = bones[base + max(boneIds[0], 0)] * weights[0];
+        skin += bones[base + max(boneIds[1], 0)] * weights[1];
+        skin += bones[base + max(boneIds[2], 0)] * weights[2];
+        skin += bones[base + max(boneIds[3], 0)] * weights[3];
+    }
+
+    mat4 final_mat = draw.transform * skin;
+    gl_Position = projection * view * final_mat * vec4(pos, 1.0);
+
+    normal = mat3(transpose(inverse(final_mat))) * norm;
+    texCoords = tc;
+    materialId = draw.palette.z;
+    tint = vec3(1.0);
+
+    fragPos = vec3(final_mat * vec4(pos, 1.0));
+}
@@ -0,0 +1,69 @@
+#version 460
+
+// copies of a model drawn by Model::renderInstances, every copy reads its
+// transform, tint and matrices from the storage buffers
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tc;
+layout(location = 3) in vec4 weights;
+layout(location = 4) in ivec4 boneIds;
+
+struct ModelInstance {
+    mat4 transform;
+    vec4 tint;
+    // x first matrix of the copy in the bone buffer
+    ivec4 palette;
+};
+
+layout(std430, row_major, binding = 0) readonly buffer Instances {
+    ModelInstance instances[];
+};
+
+// palettes of every copy
+layout(std430, row_major, binding = 1) readonly buffer Bones {
+    mat4 bones[];
+};
+
+// matrix of the mesh within a copy's block: start of its skin's palette, or
+// the joint matrix of a rigid mesh
+uniform int paletteSlot;
+uniform bool rigid;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 normal;
+out vec3 fragPos;
+out vec2 texCoords;
+out vec3 tint;
+// the depth prepass and the color pass must compute the same depth
+invariant gl_Position;
+// material buffer index of the draw
+uniform int material;
+flat out int materialId;
+
+void main() {
+    ModelInstance instance = instances[gl_InstanceID];
+    int base = instance.palette.x + paletteSlot;
+
+    mat4 skin;
+    if (rigid) {
+        skin = bones[base];
+    } else {
+        skin = bones[base + max(boneIds[0], 0)] * weights[0];
+        skin += bones[base + max(boneIds[1], 0)] * weights[1];
+        skin += bones[base + max(boneIds[2], 0)] * weights[2];
+        skin += bones[base + max(boneIds[3], 0)] * weights[3];
+    }
+
+    mat4 final_mat = instance.transform * skin;
+    gl_Position = projection * view * final_mat * vec4(pos, 1.0);
+
+    normal = mat3(transpose(inverse(final_mat))) * norm;
+    texCoords = tc;
+    materialId = material;
+    tint = instance.tint.rgb;
+
+    fragPos = vec3(final_mat * vec4(pos, 1.0));
+}
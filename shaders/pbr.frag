@@ -1,30 +1,70 @@
 //physical besed rendering fragment shader
 #version 460
 
+// variants built by ShaderVariants may define
+// HAS_BASE_TEX, HAS_METALLIC_MAP: 0 or 1 when every material drawn with the
+// variant has or lacks the texture, read from the material flags otherwise
+// MAX_LIGHTS: most lights shaded per fragment, LightClusters::maxClusterLights
+
 in vec3 normal;
 in vec3 fragPos;
 in vec2 texCoords;
+// per copy color of instanced draws, white otherwise
+in vec3 tint;
 
-#define MAX_LIGHTS 20
-uniform struct Light {
-    vec3 color;
+#ifndef MAX_LIGHTS
+#define MAX_LIGHTS 128
+#endif
+struct PointLight {
     vec3 position;
-} lights[MAX_LIGHTS];
-uniform int lightCount;
+    float radius;
+    vec3 color;
+    float padding;
+};
+// lights assigned to clusters of the view frustum, see LightClusters
+layout(std430, binding = 4) readonly buffer Lights {
+    PointLight lights[];
+};
+// offset and count of each cluster's lights in clusterLights
+layout(std430, binding = 5) readonly buffer ClusterRanges {
+    uvec2 clusterRanges[];
+};
+layout(std430, binding = 6) readonly buffer ClusterLights {
+    uint clusterLights[];
+};
+uniform int clusterTilesX;
+uniform int clusterTilesY;
+uniform int clusterSlices;
+// slice = log(depth) * clusterScale + clusterBias
+uniform float clusterScale;
+uniform float clusterBias;
+
+uniform mat4 view;
+uniform mat4 projection;
 
 uniform vec3 camPos;
 
 /*** material defination ***/
-uniform vec4 baseColor; // or emissive factor
-uniform float metallicFactor;
-uniform float roughness;
-uniform float ao;
-
-uniform sampler2D albedoMap;
-uniform sampler2D metallicMap;
-uniform sampler2D normalMap;
-uniform bool hasBaseTexture;
-uniform bool hasMetallicMap;
+// factors of every loaded material, see MaterialBuffer
+struct Material {
+    vec4 baseColor; // or emissive factor
+    float metallicFactor;
+    float roughness;
+    float ao;
+    int flags; // 1 base texture, 2 metallic map
+    // texture array * 65536 + layer
+    int baseTexture;
+    int metallicTexture;
+};
+layout(std430, binding = 3) readonly buffer Materials {
+    Material materials[];
+};
+// selected by the draw
+flat in int materialId;
+
+// material textures, see TextureArrays
+#define MAX_TEXTURE_ARRAYS 4
+layout(binding = 4) uniform sampler2DArray textureArrays[MAX_TEXTURE_ARRAYS];
 
 out vec4 color;
 
@@ -39,16 +79,38 @@ const float PI = 3.14159265359;
 // also can be used to create a lazy fog effect
 float blend(float far);
 
+vec4 sampleMaterialTexture(int reference, vec2 dx, vec2 dy);
+
 //_________________________________________________________________________
 void main() {
-    vec3 albedo = pow(baseColor.xyz, vec3(2.2));
+    Material material = materials[materialId];
+    float roughness = material.roughness;
+    float ao = material.ao;
+
+    // the texture lookups sit in branches, take the derivatives out here
+    vec2 dx = dFdx(texCoords);
+    vec2 dy = dFdy(texCoords);
+
+#ifdef HAS_BASE_TEX
+    const bool hasBaseTexture = HAS_BASE_TEX != 0;
+#else
+    bool hasBaseTexture = (material.flags & 1) != 0;
+#endif
+#ifdef HAS_METALLIC_MAP
+    const bool hasMetallicMap = HAS_METALLIC_MAP != 0;
+#else
+    bool hasMetallicMap = (material.flags & 2) != 0;
+#endif
+
+    vec3 albedo = pow(material.baseColor.xyz, vec3(2.2));
     if(hasBaseTexture) {
-        albedo = pow(texture(albedoMap, texCoords).rgb, vec3(2.2));
+        albedo = pow(sampleMaterialTexture(material.baseTexture, dx, dy).rgb, vec3(2.2));
     }
+    albedo *= tint;
 
-    float metallic = metallicFactor;
+    float metallic = material.metallicFactor;
     if(hasMetallicMap) {
-        metallic = texture(metallicMap, texCoords).r;
+        metallic = sampleMaterialTexture(material.metallicTexture, dx, dy).r;
     }
 
     vec3 N = normalize(normal);
@@ -57,16 +119,31 @@ void main() {
     vec3 f0 = vec3(0.04);
     f0 = mix(f0, albedo, metallic);
 
+    // cluster of the fragment
+    vec4 viewPos = view * vec4(fragPos, 1.0);
+    vec4 clipPos = projection * viewPos;
+    vec2 screen = clipPos.xy / clipPos.w * 0.5 + 0.5;
+    int tileX = clamp(int(screen.x * float(clusterTilesX)), 0, clusterTilesX - 1);
+    int tileY = clamp(int(screen.y * float(clusterTilesY)), 0, clusterTilesY - 1);
+    int slice = clamp(int(log(-viewPos.z) * clusterScale + clusterBias), 0, clusterSlices - 1);
+    uvec2 cluster = clusterRanges[(slice * clusterTilesY + tileY) * clusterTilesX + tileX];
+
     vec3 lo = vec3(0.0);
-    for(int i = 0; i < lightCount; i++) {
-        vec3 L = normalize(lights[i].position - fragPos);
+    for(int i = 0; i < MAX_LIGHTS; i++) {
+        if(i >= int(cluster.y)) {
+            break;
+        }
+        PointLight light = lights[clusterLights[cluster.x + uint(i)]];
+        vec3 L = normalize(light.position - fragPos);
         vec3 H = normalize(V + L);
 
         //the attenuation works alittle too well...
 
-        float distance = length(lights[i].position - fragPos);
+        float distance = length(light.position - fragPos);
         float attenuation = 1.0 / (distance * 2.0);
-        vec3 radiance = lights[i].color * attenuation;
+        // faded to zero at the radius so the light can be culled there
+        attenuation *= pow(clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0), 2.0);
+        vec3 radiance = light.color * attenuation;
 
         float NDF = distributionGGX(N, H, roughness);
         float G = geometrySmith(N, V, L, roughness);
@@ -139,6 +216,22 @@ vec3 frenselSchlick(float cosTheta, vec3 f0) {
     return f0 + (1.0 - f0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
 }
 //_________________________________________________________________________
+vec4 sampleMaterialTexture(int reference, vec2 dx, vec2 dy) {
+    vec3 uv = vec3(texCoords, float(reference & 0xffff));
+    // samplers can only be indexed by constants here
+    switch(reference >> 16) {
+    case 0:
+        return textureGrad(textureArrays[0], uv, dx, dy);
+    case 1:
+        return textureGrad(textureArrays[1], uv, dx, dy);
+    case 2:
+        return textureGrad(textureArrays[2], uv, dx, dy);
+    case 3:
+        return textureGrad(textureArrays[3], uv, dx, dy);
+    }
+    return vec4(1.0);
+}
+//_________________________________________________________________________
 float blend(float far) {
     float distance = clamp(length(fragPos - camPos), 0.0, far);
     return (pow(distance / far, 2.0));
@@ -1,8 +1,16 @@
 #version 460
 
+// built by ShaderVariants, which defines
+// SKINNED: vertices follow the joints of the draw's palette
+// BONE_INFLUENCES: joints weighted per vertex, 1 to 4
+
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 norm;
 layout(location = 2) in vec2 tc;
+#ifdef SKINNED
+layout(location = 3) in vec4 weights;
+layout(location = 4) in ivec4 boneIds;
+#endif
 
 uniform mat4 transform;
 uniform mat4 view;
@@ -11,13 +19,39 @@ uniform mat4 projection;
 out vec3 normal;
 out vec3 fragPos;
 out vec2 texCoords;
+out vec3 tint;
+// the depth prepass and the color pass must compute the same depth
+invariant gl_Position;
+// material buffer index of the draw
+uniform int material;
+flat out int materialId;
+
+#ifdef SKINNED
+#ifndef BONE_INFLUENCES
+#define BONE_INFLUENCES 4
+#endif
+const int MAX_BONES = 300;
+uniform mat4 boneMats[MAX_BONES];
+#endif
 
 void main() {
 
-    fragPos = vec3(transform * vec4(pos, 1.0));
-    normal = mat3(transpose(inverse(transform))) * norm;
+#ifdef SKINNED
+    mat4 skin = boneMats[boneIds[0]] * weights[0];
+    for(int i = 1; i < BONE_INFLUENCES; i++) {
+        skin += boneMats[boneIds[i]] * weights[i];
+    }
+    mat4 world = transform * skin;
+#else
+    mat4 world = transform;
+#endif
+
+    fragPos = vec3(world * vec4(pos, 1.0));
+    normal = mat3(transpose(inverse(world))) * norm;
     texCoords = tc;
+    materialId = material;
+    tint = vec3(1.0);
 
-    gl_Position = projection * view * transform * vec4(pos, 1.0);
+    gl_Position = projection * view * world * vec4(pos, 1.0);
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,32 @@
+#version 460
+
+// skinning pre-pass, see SkinningPass. draws the vertices of a mesh as
+// points with the rasterizer off, transform feedback captures them skinned
+// into model space so later passes draw them as static geometry
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 3) in vec4 weights;
+layout(location = 4) in ivec4 boneIds;
+
+// SkinnedVertex
+layout(xfb_buffer = 0, xfb_stride = 24) out;
+layout(xfb_offset = 0) out vec3 skinnedPos;
+layout(xfb_offset = 12) out vec3 skinnedNorm;
+
+#ifndef BONE_INFLUENCES
+#define BONE_INFLUENCES 4
+#endif
+const int MAX_BONES = 300;
+uniform mat4 boneMats[MAX_BONES];
+
+void main() {
+    mat4 skin = boneMats[boneIds[0]] * weights[0];
+    for(int i = 1; i < BONE_INFLUENCES; i++) {
+        skin += boneMats[boneIds[i]] * weights[i];
+    }
+
+    skinnedPos = vec3(skin * vec4(pos, 1.0));
+    // the draw's transform applies its own inverse transpose on top
+    skinnedNorm = mat3(transpose(inverse(skin))) * norm;
+}
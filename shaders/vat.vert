@@ -0,0 +1,79 @@
+#version 460
+
+// skinned instances animated from a baked animation texture, see
+// AnimationTexture. the cpu only uploads the instances once and a shared time
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tc;
+layout(location = 3) in vec4 weights;
+layout(location = 4) in ivec4 boneIds;
+
+struct AnimationInstance {
+    mat4 transform;
+    // x first row of the clip, y rows of the clip, z time offset, w rows per second
+    vec4 animation;
+};
+
+layout(std430, row_major, binding = 0) readonly buffer Instances {
+    AnimationInstance instances[];
+};
+
+// 3 texels per joint holding the top 3 rows of its skinning matrix
+layout(binding = 3) uniform sampler2D animationTex;
+// joint column where the palette of the mesh's skin starts
+uniform int paletteOffset;
+uniform float time;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 normal;
+out vec3 fragPos;
+out vec2 texCoords;
+out vec3 tint;
+// the depth prepass and the color pass must compute the same depth
+invariant gl_Position;
+// material buffer index of the draw
+uniform int material;
+flat out int materialId;
+
+mat4 fetchBone(int row, int bone) {
+    int x = (paletteOffset + max(bone, 0)) * 3;
+    vec4 r0 = texelFetch(animationTex, ivec2(x, row), 0);
+    vec4 r1 = texelFetch(animationTex, ivec2(x + 1, row), 0);
+    vec4 r2 = texelFetch(animationTex, ivec2(x + 2, row), 0);
+    // glsl builds matrices from columns
+    return transpose(mat4(r0, r1, r2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+mat4 fetchSkin(int row) {
+    mat4 skin = fetchBone(row, boneIds[0]) * weights[0];
+    skin += fetchBone(row, boneIds[1]) * weights[1];
+    skin += fetchBone(row, boneIds[2]) * weights[2];
+    skin += fetchBone(row, boneIds[3]) * weights[3];
+    return skin;
+}
+
+void main() {
+    AnimationInstance instance = instances[gl_InstanceID];
+
+    // the last row of a clip holds its end, wrap over the intervals
+    float intervals = max(instance.animation.y - 1.0, 1.0);
+    float frame = mod((time + instance.animation.z) * instance.animation.w, intervals);
+    int row = int(instance.animation.x) + int(frame);
+    int next = min(row + 1, int(instance.animation.x + instance.animation.y) - 1);
+
+    float t = fract(frame);
+    mat4 skin = fetchSkin(row) * (1.0 - t) + fetchSkin(next) * t;
+
+    mat4 final_mat = instance.transform * skin;
+    gl_Position = projection * view * final_mat * vec4(pos, 1.0);
+
+    normal = mat3(transpose(inverse(final_mat))) * norm;
+    texCoords = tc;
+    materialId = material;
+    tint = vec3(1.0);
+
+    fragPos = vec3(final_mat * vec4(pos, 1.0));
+}
@@ -7,6 +7,8 @@ Camera::Camera()
       front(Vector3f(0.0, 0.0, 1.0)),
       velocity(20.0),
       sensitivity(0.1),
+      nearPlane(1e-1),
+      farPlane(1e3),
       pitch(0.0),
       yaw(to_radians(90.0f)) {}
 
@@ -16,7 +18,7 @@ Mat4x4 Camera::view()
 }
 Mat4x4 Camera::projection(float ratio)
 {
-  return perspective(fov, ratio, 1e-1, 1e3);
+  return perspective(fov, ratio, this->nearPlane, this->farPlane);
 }
 void Camera::moveForwards(float delta)
 {
@@ -17,6 +17,9 @@ public:
   Vector3f front;
   float velocity;
   float sensitivity;
+  // clip planes of the projection
+  float nearPlane;
+  float farPlane;
 
   Mat4x4 view();
   Mat4x4 projection(float ratio);
@@ -1,5 +1,9 @@
 #include "viewer.h"
 #include "../model/model.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
 
 Viewer::Viewer()
     : camera(new Camera()),
@@ -7,23 +11,63 @@ Viewer::Viewer()
       lightDir(Vector3f(0.5, -0.5, 0.5)),
       phongStatic(nullptr),
       phongAnimated(nullptr),
-      pbrStatic(nullptr),
-      pbrAnimated(nullptr) {}
+      pbrVariants(nullptr),
+      pbrCrowd(nullptr),
+      pbrInstanced(nullptr),
+      pbrIndirect(nullptr),
+      depthVariants(nullptr),
+      depthCrowd(nullptr),
+      depthInstanced(nullptr),
+      depthIndirect(nullptr),
+      passQueries{0, 0},
+      passQueriesPending(false),
+      prepassTimed(false),
+      crowdBuffer(0),
+      crowdBufferSize(0),
+      time(0.0f),
+      copiesModel("None"),
+      copiesCount(1),
+      fixedLights(0),
+      scatteredCount(0) {}
 
 Viewer::~Viewer()
 {
   delete this->camera;
 
-  if (this->pbrAnimated != nullptr)
+  if (this->pbrVariants != nullptr)
   {
-    this->pbrAnimated->clean();
-    delete this->pbrAnimated;
+    this->pbrVariants->clean();
+    delete this->pbrVariants;
   }
-  if (this->pbrStatic != nullptr)
+  if (this->pbrCrowd != nullptr)
   {
-    this->pbrStatic->clean();
-    delete this->pbrStatic;
+    this->pbrCrowd->clean();
+    delete this->pbrCrowd;
   }
+  if (this->pbrInstanced != nullptr)
+  {
+    this->pbrInstanced->clean();
+    delete this->pbrInstanced;
+  }
+  if (this->pbrIndirect != nullptr)
+  {
+    this->pbrIndirect->clean();
+    delete this->pbrIndirect;
+  }
+  if (this->depthVariants != nullptr)
+  {
+    this->depthVariants->clean();
+    delete this->depthVariants;
+  }
+  for (Shader *shader : {this->depthCrowd, this->depthInstanced, this->depthIndirect})
+  {
+    if (shader != nullptr)
+    {
+      shader->clean();
+      delete shader;
+    }
+  }
+  glDeleteQueries(2, this->passQueries);
   if (this->phongStatic != nullptr)
   {
     this->phongStatic->clean();
@@ -40,6 +84,21 @@ Viewer::~Viewer()
     model.second->clean();
     delete model.second;
   }
+
+  for (auto &texture : animationTextures)
+  {
+    texture.second->clean();
+    delete texture.second;
+  }
+  if (this->crowdBuffer != 0)
+  {
+    glDeleteBuffers(1, &this->crowdBuffer);
+  }
+  this->geometryPool.clean();
+  this->materialBuffer.clean();
+  this->textureArrays.clean();
+  this->lightClusters.clean();
+  this->skinningPass.clean();
 }
 Model *Viewer::getCurrModel()
 {
@@ -52,38 +111,63 @@ Model *Viewer::getCurrModel()
 
 void Viewer::init()
 {
-  this->phongStatic = new Shader("shaders/shader.vert", "shaders/shader.frag");
-  this->phongAnimated = new Shader("shaders/animation.vert", "shaders/shader.frag");
-  this->pbrStatic = new Shader("shaders/shader.vert", "shaders/pbr.frag");
-  this->pbrAnimated = new Shader("shaders/animation.vert", "shaders/pbr.frag");
+  this->lights.push_back(
+      {.color = {300.0, 300.0, 300.0}, .position = {60.0, 10.0, -60.0}});
+  this->lights.push_back(
+      {.color = {300.0, 300.0, 300.0}, .position = {60.0, 10.0, 60.0}});
+  this->lights.push_back(
+      {.color = {300.0, 300.0, 300.0}, .position = {-60.0, 10.0, 60.0}});
+  this->lights.push_back(
+      {.color = {300.0, 300.0, 300.0}, .position = {-60.0, 10.0, -60.0}});
+  this->fixedLights = this->lights.size();
+  this->pbrFeatures.maxLights = LightClusters::maxClusterLights;
+
+  this->phongStatic = new Shader();
+  this->phongAnimated = new Shader();
+  this->pbrVariants = new ShaderVariants("shaders/shader.vert", "shaders/pbr.frag");
+  this->pbrCrowd = new Shader();
+  this->pbrInstanced = new Shader();
+  this->pbrIndirect = new Shader();
+  this->depthVariants = new ShaderVariants("shaders/shader.vert", "shaders/depth.frag", false);
+  this->depthCrowd = new Shader();
+  this->depthInstanced = new Shader();
+  this->depthIndirect = new Shader();
+
+  // every program is submitted before waiting on any, so the driver can
+  // build them side by side (cached binaries load right away)
+  this->phongStatic->compile("shaders/shader.vert", "shaders/shader.frag");
+  this->phongAnimated->compile("shaders/shader.vert", "shaders/shader.frag", "#define SKINNED\n");
+  // these draw many materials per call, so they keep the material flags
+  std::string lightDefines = "#define MAX_LIGHTS " + std::to_string(LightClusters::maxClusterLights) + "\n";
+  this->pbrCrowd->compile("shaders/vat.vert", "shaders/pbr.frag", lightDefines);
+  this->pbrInstanced->compile("shaders/instanced.vert", "shaders/pbr.frag", lightDefines);
+  this->pbrIndirect->compile("shaders/indirect.vert", "shaders/pbr.frag", lightDefines);
+  this->depthCrowd->compile("shaders/vat.vert", "shaders/depth.frag");
+  this->depthInstanced->compile("shaders/instanced.vert", "shaders/depth.frag");
+  this->depthIndirect->compile("shaders/indirect.vert", "shaders/depth.frag");
 
   // Initialize debug renderer
   this->debugRenderer.init();
 
+  for (Shader *shader : {this->phongStatic, this->phongAnimated, this->pbrCrowd,
+                         this->pbrInstanced, this->pbrIndirect, this->depthCrowd,
+                         this->depthInstanced, this->depthIndirect})
+  {
+    shader->finish();
+  }
+
+  glCreateQueries(GL_TIME_ELAPSED, 2, this->passQueries);
+
+  this->phongStatic->use();
+
   this->phongStatic->updateInt("baseTex", 0);
   this->phongStatic->updateInt("metallicMap", 1);
   this->phongStatic->updateInt("normalMap", 2);
 
+  this->phongAnimated->use();
   this->phongAnimated->updateInt("albedoMap", 0);
   this->phongAnimated->updateInt("metallicMap", 1);
   this->phongAnimated->updateInt("normalMap", 2);
-
-  this->pbrStatic->updateInt("albedoMap", 0);
-  this->pbrStatic->updateInt("metallicMap", 1);
-  this->pbrStatic->updateInt("normalMap", 2);
-
-  this->pbrAnimated->updateInt("albedoMap", 0);
-  this->pbrAnimated->updateInt("metallicMap", 1);
-  this->pbrAnimated->updateInt("normalMap", 2);
-
-  this->lights.push_back(
-      {.color = {300.0, 300.0, 300.0}, .position = {60.0, 10.0, -60.0}});
-  this->lights.push_back(
-      {.color = {300.0, 300.0, 300.0}, .position = {60.0, 10.0, 60.0}});
-  this->lights.push_back(
-      {.color = {300.0, 300.0, 300.0}, .position = {-60.0, 10.0, 60.0}});
-  this->lights.push_back(
-      {.color = {300.0, 300.0, 300.0}, .position = {-60.0, 10.0, -60.0}});
 }
 
 void Viewer::addModel(std::string name, std::string path)
@@ -93,7 +177,10 @@ void Viewer::addModel(std::string name, std::string path)
     std::cout << "\nAdding model: " << name << " from path: " << path << std::endl;
 
     Model *model = new Model();
-    GLTFFile file = GLTFFile(path);
+    GLTFImportSettings settings;
+    settings.reduceKeys = true;
+    settings.compressClips = true;
+    GLTFFile file = GLTFFile(path, settings);
     file.populateModel(*model);
 
     // Validate model data
@@ -106,12 +193,48 @@ void Viewer::addModel(std::string name, std::string path)
       std::cout << "Model loaded successfully with " << model->meshes.size() << " meshes" << std::endl;
     }
 
+    // textures become layers of the shared arrays
+    std::vector<int> textureLayers;
+    for (auto &texture : model->textures)
+    {
+      textureLayers.push_back(this->textureArrays.add(texture));
+    }
+    this->textureArrays.build();
+    for (auto &texture : model->textures)
+    {
+      texture.clean();
+    }
+    model->textures.clear();
+
+    // meshes draw from the shared buffers from now on
+    for (auto &mesh : model->meshes)
+    {
+      this->geometryPool.add(mesh);
+
+      int baseTexture = mesh.material.baseTex != -1 ? textureLayers[mesh.material.baseTex] : -1;
+      int metallicTexture = mesh.material.metallicMap != -1 ? textureLayers[mesh.material.metallicMap] : -1;
+      this->materialBuffer.add(mesh.material, baseTexture, metallicTexture);
+    }
+    this->geometryPool.upload();
+    this->materialBuffer.upload();
+    this->skinningPass.resize(this->geometryPool);
+    for (auto &mesh : model->meshes)
+    {
+      this->skinningPass.prepare(mesh);
+    }
+    model->prepareShaders(*this->pbrVariants, this->pbrFeatures);
+    model->prepareShaders(*this->depthVariants, this->pbrFeatures);
+
     model->scale(Vector3f(2.0));
     model->orient(Quat(180.0, Vector3f(0.0, 1.0, 0.0)));
     model->translate(Vector3f(0.0, 0.0, 5.0));
 
-    model->animController->setCurrentAnimation(0);
-    model->animController->play();
+    if (model->animController != nullptr)
+    {
+      model->animController->setPoseCache(&this->poseCache);
+      model->animController->setCurrentAnimation(0);
+      model->animController->play();
+    }
     this->models.insert(std::make_pair(name, model));
 
     std::cout << "Model added successfully" << std::endl;
@@ -123,6 +246,13 @@ void Viewer::addModel(std::string name, std::string path)
   }
 }
 
+bool Viewer::usesRenderQueue() const
+{
+  return !this->showCrowd && this->copies <= 1 && !this->indirectDraws;
+}
+
+size_t Viewer::textureMemory() const { return this->textureArrays.memory(); }
+
 std::vector<std::string> Viewer::getModelNames()
 {
   std::vector<std::string> names;
@@ -135,6 +265,7 @@ std::vector<std::string> Viewer::getModelNames()
 
 void Viewer::update(float ratio, float delta)
 {
+  GLState::beginFrame();
 
   this->phongStatic->use();
   this->phongStatic->updateVec3("lightDirection", this->lightDir);
@@ -148,19 +279,85 @@ void Viewer::update(float ratio, float delta)
   this->phongAnimated->updateMat4("view", this->camera->view());
   this->phongAnimated->updateMat4("projection", this->camera->projection(ratio));
 
-  this->pbrStatic->use();
-  this->pbrStatic->updateVec3("lightDirection", this->lightDir);
-  this->pbrStatic->updateVec3("camPos", this->camera->pos);
-  this->pbrStatic->updateMat4("view", this->camera->view());
-  this->pbrStatic->updateMat4("projection", this->camera->projection(ratio));
+  this->time += delta;
+
+  // lights move every frame, so they are assigned to clusters every frame
+  if (this->scatteredCount != this->scatteredLights)
+  {
+    this->scatterLights();
+  }
+  this->pointLights.resize(this->lights.size());
+  for (size_t i = 0; i < this->lights.size(); ++i)
+  {
+    const Light &light = this->lights[i];
+    Quat spin(to_degrees(light.orbit * this->time), Vector3f(0.0, 1.0, 0.0));
+    Vector3f position = spin * light.position;
+
+    PointLight &pointLight = this->pointLights[i];
+    pointLight.position[0] = position.x;
+    pointLight.position[1] = position.y;
+    pointLight.position[2] = position.z;
+    pointLight.radius = light.radius;
+    pointLight.color[0] = light.color.x;
+    pointLight.color[1] = light.color.y;
+    pointLight.color[2] = light.color.z;
+    pointLight.padding = 0.0f;
+  }
+  this->lightClusters.update(this->pointLights, this->camera->view(), this->camera->fov, ratio,
+                             this->camera->nearPlane, this->camera->farPlane);
+
+  std::vector<Shader *> shaders = this->pbrVariants->getShaders();
+  shaders.insert(shaders.end(), {this->pbrCrowd, this->pbrInstanced, this->pbrIndirect});
+  for (Shader *shader : shaders)
+  {
+    shader->use();
+    shader->updateVec3("camPos", this->camera->pos);
+    shader->updateMat4("view", this->camera->view());
+    shader->updateMat4("projection", this->camera->projection(ratio));
+    this->lightClusters.configShader(*shader);
+  }
+
+  std::vector<Shader *> depthShaders = this->depthVariants->getShaders();
+  depthShaders.insert(depthShaders.end(), {this->depthCrowd, this->depthInstanced, this->depthIndirect});
+  for (Shader *shader : depthShaders)
+  {
+    shader->use();
+    shader->updateMat4("view", this->camera->view());
+    shader->updateMat4("projection", this->camera->projection(ratio));
+  }
+
+  this->poseCache.beginFrame();
 
-  this->pbrAnimated->use();
-  this->pbrAnimated->updateVec3("lightDirection", this->lightDir);
-  this->pbrAnimated->updateVec3("camPos", this->camera->pos);
-  this->pbrAnimated->updateMat4("view", this->camera->view());
-  this->pbrAnimated->updateMat4("projection", this->camera->projection(ratio));
+  Controller *controller = this->models[this->currModel]->animController;
+  if (controller != nullptr)
+  {
+    controller->update(delta);
+  }
+
+  if (this->copiesModel != this->currModel || this->copiesCount != this->copies)
+  {
+    this->layoutCopies();
+  }
+  Model *model = this->models[this->currModel];
+  model->updateInstances(delta);
 
-  this->models[this->currModel]->animController->update(delta);
+  // both passes draw the copies, so they are culled once per frame here
+  if (this->occlusionCulling && this->copies > 1 && !this->showCrowd)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    this->occlusionCuller.begin(this->camera->projection(ratio) * this->camera->view());
+    model->cullInstances(this->occlusionCuller, this->camera->pos, this->occluderCopies);
+    auto end = std::chrono::high_resolution_clock::now();
+    this->cullTime = std::chrono::duration<float, std::milli>(end - start).count();
+  }
+  else
+  {
+    for (size_t i = 0; i < model->instanceCount(); ++i)
+    {
+      model->getInstance(i).visible = true;
+    }
+    this->cullTime = 0.0f;
+  }
 }
 
 void Viewer::renderCurrModel()
@@ -212,31 +409,193 @@ void Viewer::renderCurrModel()
     this->models[this->currModel]->render(*this->pbrStatic);
   }
  */
-  this->pbrAnimated->use();
   // this->pbrAnimated->updateInt("textured", false);
   if (this->currModel != "None")
   {
+    // every pbr shader reads its factors and textures from here
+    this->materialBuffer.bind(3);
+    this->textureArrays.bind(4);
+    this->lightClusters.bind(4);
+
+    // the queue is the only path that draws skinned meshes from the pool
+    // with per frame palettes
+    this->skinningPass.beginFrame();
+    if (this->skinOnce && this->usesRenderQueue())
+    {
+      this->models[this->currModel]->skin(this->skinningPass, this->cpuSkinning);
+    }
 
-    for (size_t i = 0; i < this->lights.size(); ++i)
+    // queries are only reused once their results are read
+    this->readPassTimes();
+    bool timing = !this->passQueriesPending;
+    if (timing)
     {
+      this->prepassTimed = false;
+    }
 
-      const Light &light = this->lights[i];
-      this->pbrAnimated->updateInt("lightCount", int(this->lights.size()));
-      std::string value = "lights[" + std::to_string(i) + "]";
-      this->pbrAnimated->updateVec3((value + ".color").c_str(), light.color);
-      this->pbrAnimated->updateVec3((value + ".position").c_str(), light.position);
+    if (this->depthPrepass)
+    {
+      if (timing)
+      {
+        glBeginQuery(GL_TIME_ELAPSED, this->passQueries[0]);
+      }
+      GLState::colorMask(false);
+      GLState::depthMask(true);
+      GLState::depthFunc(GL_LESS);
+      this->renderModel(true);
+      // the other paths don't go through the queue, its stats would be stale
+      this->prepassStats = this->usesRenderQueue() ? this->renderQueue.getStats() : RenderStats();
+      if (timing)
+      {
+        glEndQuery(GL_TIME_ELAPSED);
+        this->prepassTimed = true;
+      }
+
+      // only the fragments that won the prepass get shaded
+      GLState::colorMask(true);
+      GLState::depthMask(false);
+      GLState::depthFunc(GL_EQUAL);
+    }
+    else
+    {
+      this->prepassStats = RenderStats();
+      this->prepassTime = 0.0f;
+    }
+
+    if (timing)
+    {
+      glBeginQuery(GL_TIME_ELAPSED, this->passQueries[1]);
+    }
+    this->renderModel(false);
+    if (timing)
+    {
+      glEndQuery(GL_TIME_ELAPSED);
+      this->passQueriesPending = true;
+    }
+
+    GLState::depthMask(true);
+    GLState::depthFunc(GL_LESS);
+  }
+}
+
+void Viewer::renderModel(bool depthOnly)
+{
+  Model *model = this->models[this->currModel];
+
+  if (this->showCrowd)
+  {
+    this->renderCrowd(depthOnly ? *this->depthCrowd : *this->pbrCrowd);
+    return;
+  }
+
+  if (this->copies > 1)
+  {
+    model->renderInstances(depthOnly ? *this->depthInstanced : *this->pbrInstanced);
+    return;
+  }
+
+  if (this->indirectDraws)
+  {
+    // every pooled mesh of the model goes out in one multi draw
+    model->renderIndirect(depthOnly ? *this->depthIndirect : *this->pbrIndirect);
+    return;
+  }
+
+  // every mesh draws with the variant of its skinning and material
+  this->renderQueue.begin();
+  model->queue(this->renderQueue, depthOnly ? *this->depthVariants : *this->pbrVariants,
+               this->pbrFeatures, this->camera->pos,
+               this->skinOnce ? &this->skinningPass : nullptr);
+  this->renderQueue.submit();
+}
+
+void Viewer::readPassTimes()
+{
+  if (!this->passQueriesPending)
+  {
+    return;
+  }
+
+  GLint available = 0;
+  glGetQueryObjectiv(this->passQueries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available == 0)
+  {
+    return;
+  }
+
+  GLuint64 elapsed = 0;
+  if (this->prepassTimed)
+  {
+    glGetQueryObjectui64v(this->passQueries[0], GL_QUERY_RESULT, &elapsed);
+    this->prepassTime = (float)elapsed / 1e6f;
+  }
+  glGetQueryObjectui64v(this->passQueries[1], GL_QUERY_RESULT, &elapsed);
+  this->colorPassTime = (float)elapsed / 1e6f;
+  this->passQueriesPending = false;
+}
+
+void Viewer::renderCrowd(Shader &shader)
+{
+  Model *model = this->models[this->currModel];
+  if (model->animController == nullptr || model->animController->clipCount() == 0)
+  {
+    return;
+  }
+
+  AnimationTexture *animation = this->animationTextures[this->currModel];
+  if (animation != nullptr && animation->id == 0)
+  {
+    return;
+  }
+  if (animation == nullptr)
+  {
+    animation = new AnimationTexture();
+    animation->bake(*model->animController, 30.0f);
+    bool uploaded = animation->upload();
+    // kept even when the upload failed so it isn't baked again every frame
+    this->animationTextures[this->currModel] = animation;
+    if (!uploaded)
+    {
+      std::cout << "Crowd of " << this->currModel << " can't be drawn without its animation texture"
+                << std::endl;
+      return;
     }
 
-    this->pbrAnimated->updateMat4("transform", this->models[this->currModel]->get_transform());
+    std::cout << "Baked " << animation->clipCount() << " clips of " << this->currModel
+              << " into a " << animation->width << "x" << animation->height
+              << " animation texture (" << animation->memory() / 1024 << " KiB)" << std::endl;
+  }
 
-    std::vector<Mat4x4> mats = this->models[this->currModel]->animController->getPose();
-    for (size_t i = 0; i < mats.size(); i++)
+  // instances only change with the crowd, the animation runs on the gpu
+  if (this->crowdBufferSize != this->crowdSize || this->crowdBufferModel != this->currModel)
+  {
+    float spacing = this->getGridSpacing(*model);
+    std::vector<AnimationInstance> instances;
+    instances.reserve(this->crowdSize);
+    for (int i = 0; i < this->crowdSize; ++i)
     {
-      std::string value = "boneMats[" + std::to_string(i) + "]";
-      this->pbrAnimated->updateMat4(value.c_str(), mats[i]);
+      Transform offset = this->getGridCell(i, this->crowdSize, spacing);
+
+      size_t clip = (size_t)i % animation->clipCount();
+      float duration = animation->getClip(clip).duration;
+      float start = duration * fmodf((float)i * 0.618034f, 1.0f);
+      instances.push_back(animation->getInstance(model->get_transform() * offset.get(), clip, start));
     }
-    this->models[this->currModel]->render(*this->pbrAnimated);
+
+    if (this->crowdBuffer == 0)
+    {
+      glCreateBuffers(1, &this->crowdBuffer);
+    }
+    glNamedBufferData(this->crowdBuffer, instances.size() * sizeof(AnimationInstance),
+                      instances.data(), GL_STATIC_DRAW);
+    this->crowdBufferSize = this->crowdSize;
+    this->crowdBufferModel = this->currModel;
   }
+
+  shader.use();
+  shader.updateFloat("time", this->time);
+  GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->crowdBuffer);
+  model->renderInstanced(shader, *animation, this->crowdSize);
 }
 
 // Render bounding boxes if enabled
@@ -250,4 +609,86 @@ void Viewer::renderCurrModel()
     BoundingBox bbox = mesh.getBoundingBox();
     this->debugRenderer.renderBoundingBox(bbox, modelTransform, viewMat, projMat);
   }
-} */
\ No newline at end of file
+} */
+void Viewer::layoutCopies()
+{
+  if (this->copiesModel != "None")
+  {
+    this->models[this->copiesModel]->clearInstances();
+  }
+  this->copiesModel = this->currModel;
+  this->copiesCount = this->copies;
+
+  Model *model = this->models[this->currModel];
+  if (this->copies <= 1)
+  {
+    return;
+  }
+
+  float spacing = this->getGridSpacing(*model);
+  for (int i = 0; i < this->copies; ++i)
+  {
+    // a few shades so copies can be told apart
+    float shade = 0.75f + 0.25f * (float)(i % 3) / 2.0f;
+    size_t index = model->addInstance(this->getGridCell(i, this->copies, spacing),
+                                      Color3f(shade, 1.0f, 1.75f - shade));
+
+    Controller *controller = model->getInstance(index).controller;
+    if (controller != nullptr && controller->clipCount() > 0)
+    {
+      controller->setCurrentAnimation((size_t)i % controller->clipCount());
+      controller->play();
+      // a handful of phases, copies in the same phase share cached poses
+      controller->update(0.25f * (float)(i % 4));
+    }
+  }
+}
+
+float Viewer::getGridSpacing(Model &model)
+{
+  BoundingBox box;
+  for (auto &mesh : model.meshes)
+  {
+    BoundingBox meshVolume = mesh.getBoundingBox();
+    box.update(meshVolume.minPt);
+    box.update(meshVolume.maxPt);
+  }
+  return 1.5f * std::max(box.maxPt.x - box.minPt.x, box.maxPt.z - box.minPt.z);
+}
+
+Transform Viewer::getGridCell(int index, int count, float spacing)
+{
+  int side = (int)ceilf(sqrtf((float)count));
+
+  Transform cell;
+  cell.translation = Vector3f((float)(index % side - side / 2) * spacing, 0.0f,
+                              (float)(index / side) * spacing);
+  return cell;
+}
+
+void Viewer::scatterLights()
+{
+  this->lights.resize(this->fixedLights);
+
+  // same lights every time the count is picked, without touching the
+  // global rand state
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (int i = 0; i < this->scatteredLights; ++i)
+  {
+    Light light;
+    float angle = unit(generator) * 2.0f * (float)PIE;
+    float distance = 5.0f + unit(generator) * 40.0f;
+    float height = 0.5f + unit(generator) * 8.0f;
+    light.position = Point3f(cosf(angle) * distance, height, sinf(angle) * distance);
+    // one by one, argument order is unspecified
+    float red = unit(generator);
+    float green = unit(generator);
+    float blue = unit(generator);
+    light.color = Color3f(red, green, blue) * 40.0f;
+    light.radius = 4.0f + unit(generator) * 6.0f;
+    light.orbit = (unit(generator) - 0.5f) * 0.8f;
+    this->lights.push_back(light);
+  }
+  this->scatteredCount = this->scatteredLights;
+}
@@ -4,6 +4,14 @@
 #include "../math/math.h"
 #include "camera.h"
 #include "../model/renderer/debugRenderer.h"
+#include "../model/renderer/geometryPool.h"
+#include "../model/renderer/materialBuffer.h"
+#include "../model/renderer/textureArrays.h"
+#include "../model/renderer/renderQueue.h"
+#include "../model/renderer/lightClusters.h"
+#include "../model/renderer/skinningPass.h"
+#include "../model/renderer/occlusionCuller.h"
+#include "../model/animation/poseCache.h"
 #include <map>
 #include <string>
 #include <vector>
@@ -14,6 +22,10 @@ struct Light
 {
   Color3f color;
   Point3f position;
+  // distance at which the light has faded out
+  float radius{200.0f};
+  // radians per second the light circles the y axis
+  float orbit{0.0f};
 };
 
 class Viewer
@@ -30,6 +42,11 @@ public:
   void renderCurrModel();
 
   class Model *getCurrModel();
+  /// @brief true if the current model is drawn through renderQueue, the
+  /// crowd, copies and indirect paths issue their own draws
+  bool usesRenderQueue() const;
+  /// @brief bytes of the texture arrays the materials sample
+  size_t textureMemory() const;
 
   std::vector<std::string> getModelNames();
 
@@ -42,15 +59,114 @@ public:
   std::vector<Light> lights;
   bool showBoundingBoxes{true}; // Toggle for bounding box visualization
 
+  // poses shared by controllers playing the same clip in the same frame
+  PoseCache poseCache;
+
+  // draws a grid of copies of the current model animated from a baked
+  // animation texture instead of the model itself
+  bool showCrowd{false};
+  int crowdSize{100};
+
+  // draws of the frame, sorted by state before they are issued
+  RenderQueue renderQueue;
+  // draw pooled meshes with multi draw indirect instead of the queue
+  bool indirectDraws{false};
+
+  // copies of the current model drawn with one instanced draw per mesh,
+  // each animated by its own controller
+  int copies{1};
+  // skips the copies hidden behind the nearest occluderCopies ones or
+  // outside the view, tested on the cpu against a software depth buffer
+  bool occlusionCulling{false};
+  int occluderCopies{8};
+  OcclusionCuller occlusionCuller;
+  // cpu milliseconds of the last cull
+  float cullTime{0.0f};
+
+  // lays down the depth of the model before shading it, so the color pass
+  // only shades the visible fragment of each pixel
+  bool depthPrepass{false};
+  // queue stats of the depth pass, zero when the queue isn't used
+  RenderStats prepassStats;
+  // skins the model once per frame with transform feedback, the passes of
+  // the render queue then draw it as rigid geometry
+  bool skinOnce{false};
+  // the skinning pass runs on the cpu and uploads its result
+  bool cpuSkinning{false};
+  SkinningPass skinningPass;
+  // gpu milliseconds of the passes, read a frame or more late
+  float prepassTime{0.0f};
+  float colorPassTime{0.0f};
+
+  // small lights circling the model on top of the fixed ones
+  int scatteredLights{0};
+  // lights of the frame sorted into view frustum clusters
+  LightClusters lightClusters;
+
 private:
   Shader *phongStatic;
   Shader *phongAnimated;
 
-  Shader *pbrStatic;
-  Shader *pbrAnimated;
+  // pbr programs of the render queue, one per skinning and material kind
+  ShaderVariants *pbrVariants;
+  // features every variant is built with
+  ShaderFeatures pbrFeatures;
+  Shader *pbrCrowd;
+  Shader *pbrInstanced;
+  Shader *pbrIndirect;
+
+  // depth only programs of the prepass
+  ShaderVariants *depthVariants;
+  Shader *depthCrowd;
+  Shader *depthInstanced;
+  Shader *depthIndirect;
+  // GL_TIME_ELAPSED queries of the prepass and the color pass
+  unsigned int passQueries[2];
+  bool passQueriesPending;
+  bool prepassTimed;
 
   DebugRenderer debugRenderer;
+  // vertices and indices of every loaded model
+  GeometryPool geometryPool;
+  // factors of every loaded material
+  MaterialBuffer materialBuffer;
+  // textures of every loaded material
+  TextureArrays textureArrays;
   std::map<std::string, class Model *> models;
+
+  // baked on the first crowd draw of each model
+  std::map<std::string, class AnimationTexture *> animationTextures;
+  // AnimationInstance storage buffer of the crowd
+  unsigned int crowdBuffer;
+  int crowdBufferSize;
+  std::string crowdBufferModel;
+  // time shared by every crowd instance
+  float time;
+
+  // model and count the copies were laid out for
+  std::string copiesModel;
+  int copiesCount;
+
+  // lights added by init, the scattered ones follow
+  size_t fixedLights;
+  int scatteredCount;
+  // lights at their position of the frame
+  std::vector<PointLight> pointLights;
+
+  /// @brief draws the current model through the path picked in the ui
+  /// @param depthOnly uses the depth programs of the prepass
+  void renderModel(bool depthOnly);
+  void renderCrowd(Shader &shader);
+  /// @brief picks up the pass times once the gpu has them
+  void readPassTimes();
+  void layoutCopies();
+  /// @brief replaces the scattered lights with scatteredLights new ones
+  void scatterLights();
+  /// @brief model space distance between grid cells so neighbours do not
+  /// overlap
+  float getGridSpacing(class Model &model);
+  /// @brief placement of copy index of a square grid of count copies
+  Transform getGridCell(int index, int count, float spacing);
 };
 
 #endif